@@ -1,6 +1,6 @@
 /*******************************************************************************
  * File   : array_2d_transpose.hpp
- * Brief  : Transpose 2D array inplace
+ * Brief  : Transpose 2D array (inplace and out-of-place)
  *
  * Author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
  *
@@ -10,12 +10,87 @@
 #define ARRAY_2D_TRANSPOSE_HPP
 
 #include <cassert>
+#include <cmath>     // std::sqrt()
+#include <iterator>
+#include <vector>
+#include <algorithm> // std::min(), std::swap()
+#include <type_traits>
+#include <functional>
+#include <utility>   // std::move()
+#include <thread>
+#include <stdint.h>
+#include <cstddef>   // std::ptrdiff_t
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "parallel_for.hpp"
 
 namespace algo
 {
     // n rows
     // m columns
 
+    // (a * x) % d for a fixed a < d and any x < d without a division
+    // (Shoup's modular multiplication). With aq = floor(a * 2^64 / d)
+    // precomputed, q = floor(aq * x / 2^64) is the quotient or one less,
+    // so the remainder a * x - q * d (exact modulo 2^64, as it is below
+    // 2d) needs at most one correction. a * x itself is never formed,
+    // so nothing overflows as long as d < 2^63.
+    struct array_2d_mulmod
+    {
+        array_2d_mulmod(uint64_t a, uint64_t d)
+            : mult(a), mod(d), mult_q(div_hi(a, d))
+        {
+            assert(a < d && (d >> 63) == 0);
+        }
+
+        uint64_t operator()(uint64_t x) const
+        {
+            const uint64_t r = mult * x - mul_hi(mult_q, x) * mod;
+            return (r >= mod) ? r - mod : r;
+        }
+
+        // high 64 bits of x * y
+        static uint64_t mul_hi(uint64_t x, uint64_t y)
+        {
+#if defined(__SIZEOF_INT128__)
+            return (uint64_t)(((unsigned __int128)x * y) >> 64);
+#else
+            const uint64_t x0 = (uint32_t)x, x1 = x >> 32;
+            const uint64_t y0 = (uint32_t)y, y1 = y >> 32;
+            const uint64_t p01 = x0 * y1, p10 = x1 * y0;
+            const uint64_t mid = ((x0 * y0) >> 32) +
+                (uint32_t)p01 + (uint32_t)p10;
+            return x1 * y1 + (p01 >> 32) + (p10 >> 32) + (mid >> 32);
+#endif
+        }
+
+        // floor(a * 2^64 / d), a < d
+        static uint64_t div_hi(uint64_t a, uint64_t d)
+        {
+#if defined(__SIZEOF_INT128__)
+            return (uint64_t)(((unsigned __int128)a << 64) / d);
+#else
+            // long division, a bit of the quotient at a time
+            uint64_t q = 0, r = a;
+            for (int k = 0; k < 64; ++k) {
+                const bool carry = (r >> 63) != 0;
+                r <<= 1;
+                q <<= 1;
+                if (carry || r >= d) {
+                    r -= d;
+                    q |= 1;
+                }
+            }
+            return q;
+#endif
+        }
+
+        uint64_t mult, mod, mult_q;
+    };
+
     template<typename RandomIterator, typename DT =
              typename std::iterator_traits<RandomIterator>::difference_type>
     void array_2d_transpose_v1(RandomIterator arr, DT n, DT m)
@@ -26,6 +101,7 @@ namespace algo
 
         std::vector<bool> visited(n*m, false);
         const DT mn1 = m * n - 1;
+        const array_2d_mulmod next(n, mn1);
         DT cycle = 0;
 
         while (++cycle != mn1 - 1) {
@@ -34,7 +110,7 @@ namespace algo
 
                 DT i = cycle;
                 do  {
-                    i = (n * i) % mn1;
+                    i = (DT)next(i);
                     std::swap(arr[i], arr[cycle]);
                     visited[i] = true;
                 } while (i != cycle);
@@ -42,15 +118,246 @@ namespace algo
         }
     }
 
+    // L1 data cache size the blocked transposes are tuned for
+    const size_t array_2d_l1_size = 32 * 1024;
+
+    // Side of a square tile, such that one source and one destination
+    // tile fit into L1 together
+    template<typename T>
+    size_t array_2d_transpose_tile()
+    {
+        return (size_t)std::sqrt(array_2d_l1_size / (2 * sizeof(T)));
+    }
+
+    // In-register transpose of a size x size tile: the rows of src are
+    // lds elements apart, the rows of dst are ldd elements apart.
+    // Specialized for 32 and 64-bit arithmetic types with SSE2 (4x4, 2x2)
+    // and AVX (8x8, 4x4); the generic version is a 1x1 tile (a copy).
+    template<typename T, bool = std::is_arithmetic<T>::value,
+             size_t = sizeof(T)>
+    struct array_2d_transpose_kernel
+    {
+        static const size_t size = 1;
+
+        static void transpose(const T *src, size_t, T *dst, size_t)
+        {
+            *dst = *src;
+        }
+    };
+
+#if defined(__AVX__)
+
+    template<typename T>
+    struct array_2d_transpose_kernel<T, true, 4>
+    {
+        static const size_t size = 8;
+
+        static void transpose(const T *src, size_t lds, T *dst, size_t ldd)
+        {
+            const float *s = reinterpret_cast<const float*>(src);
+            float *d = reinterpret_cast<float*>(dst);
+            __m256 r0 = _mm256_loadu_ps(s + 0 * lds);
+            __m256 r1 = _mm256_loadu_ps(s + 1 * lds);
+            __m256 r2 = _mm256_loadu_ps(s + 2 * lds);
+            __m256 r3 = _mm256_loadu_ps(s + 3 * lds);
+            __m256 r4 = _mm256_loadu_ps(s + 4 * lds);
+            __m256 r5 = _mm256_loadu_ps(s + 5 * lds);
+            __m256 r6 = _mm256_loadu_ps(s + 6 * lds);
+            __m256 r7 = _mm256_loadu_ps(s + 7 * lds);
+
+            // interleave pairs of rows, then pairs of pairs within
+            // 128-bit lanes, then swap the 128-bit lanes
+            __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+            __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+            __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+            __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+            __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+            __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+            __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+            __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+
+            r0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+            r1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+            r2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+            r3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+            r4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+            r5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+            r6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+            r7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+
+            _mm256_storeu_ps(d + 0 * ldd, _mm256_permute2f128_ps(r0, r4, 0x20));
+            _mm256_storeu_ps(d + 1 * ldd, _mm256_permute2f128_ps(r1, r5, 0x20));
+            _mm256_storeu_ps(d + 2 * ldd, _mm256_permute2f128_ps(r2, r6, 0x20));
+            _mm256_storeu_ps(d + 3 * ldd, _mm256_permute2f128_ps(r3, r7, 0x20));
+            _mm256_storeu_ps(d + 4 * ldd, _mm256_permute2f128_ps(r0, r4, 0x31));
+            _mm256_storeu_ps(d + 5 * ldd, _mm256_permute2f128_ps(r1, r5, 0x31));
+            _mm256_storeu_ps(d + 6 * ldd, _mm256_permute2f128_ps(r2, r6, 0x31));
+            _mm256_storeu_ps(d + 7 * ldd, _mm256_permute2f128_ps(r3, r7, 0x31));
+        }
+    };
+
+    template<typename T>
+    struct array_2d_transpose_kernel<T, true, 8>
+    {
+        static const size_t size = 4;
+
+        static void transpose(const T *src, size_t lds, T *dst, size_t ldd)
+        {
+            const double *s = reinterpret_cast<const double*>(src);
+            double *d = reinterpret_cast<double*>(dst);
+            __m256d r0 = _mm256_loadu_pd(s + 0 * lds);
+            __m256d r1 = _mm256_loadu_pd(s + 1 * lds);
+            __m256d r2 = _mm256_loadu_pd(s + 2 * lds);
+            __m256d r3 = _mm256_loadu_pd(s + 3 * lds);
+
+            __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+            __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+            __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+            __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+            _mm256_storeu_pd(d + 0 * ldd, _mm256_permute2f128_pd(t0, t2, 0x20));
+            _mm256_storeu_pd(d + 1 * ldd, _mm256_permute2f128_pd(t1, t3, 0x20));
+            _mm256_storeu_pd(d + 2 * ldd, _mm256_permute2f128_pd(t0, t2, 0x31));
+            _mm256_storeu_pd(d + 3 * ldd, _mm256_permute2f128_pd(t1, t3, 0x31));
+        }
+    };
+
+#elif defined(__SSE2__)
+
+    template<typename T>
+    struct array_2d_transpose_kernel<T, true, 4>
+    {
+        static const size_t size = 4;
+
+        static void transpose(const T *src, size_t lds, T *dst, size_t ldd)
+        {
+            const float *s = reinterpret_cast<const float*>(src);
+            float *d = reinterpret_cast<float*>(dst);
+            __m128 r0 = _mm_loadu_ps(s + 0 * lds);
+            __m128 r1 = _mm_loadu_ps(s + 1 * lds);
+            __m128 r2 = _mm_loadu_ps(s + 2 * lds);
+            __m128 r3 = _mm_loadu_ps(s + 3 * lds);
+            _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+            _mm_storeu_ps(d + 0 * ldd, r0);
+            _mm_storeu_ps(d + 1 * ldd, r1);
+            _mm_storeu_ps(d + 2 * ldd, r2);
+            _mm_storeu_ps(d + 3 * ldd, r3);
+        }
+    };
+
+    template<typename T>
+    struct array_2d_transpose_kernel<T, true, 8>
+    {
+        static const size_t size = 2;
+
+        static void transpose(const T *src, size_t lds, T *dst, size_t ldd)
+        {
+            const double *s = reinterpret_cast<const double*>(src);
+            double *d = reinterpret_cast<double*>(dst);
+            __m128d r0 = _mm_loadu_pd(s + 0 * lds);
+            __m128d r1 = _mm_loadu_pd(s + 1 * lds);
+            _mm_storeu_pd(d + 0 * ldd, _mm_unpacklo_pd(r0, r1));
+            _mm_storeu_pd(d + 1 * ldd, _mm_unpackhi_pd(r0, r1));
+        }
+    };
+
+#endif
+
+    // In-place transpose of a square n x n array whose rows are ld
+    // elements apart (a sub-matrix of a larger array).
+    // Every element above the diagonal is swapped with its mirror, tile by
+    // tile (tiles sized to L1), so there are no cycles to follow at all.
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_square(RandomIterator arr, DT n, DT ld)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        const DT tile = std::max<DT>(1, array_2d_transpose_tile<VT>());
+
+        for (DT ib = 0; ib < n; ib += tile) {
+            const DT ie = std::min(ib + tile, n);
+            for (DT jb = ib; jb < n; jb += tile) {
+                const DT je = std::min(jb + tile, n);
+                for (DT i = ib; i < ie; ++i) {
+                    for (DT j = std::max(jb, i + 1); j < je; ++j) {
+                        std::swap(arr[i * ld + j], arr[j * ld + i]);
+                    }
+                }
+            }
+        }
+    }
+
+    // In-place transpose of a square n x n array
     template<typename RandomIterator, typename DT =
              typename std::iterator_traits<RandomIterator>::difference_type>
-    void array_2d_transpose(RandomIterator arr, DT n, DT m)
+    void array_2d_transpose_square(RandomIterator arr, DT n)
+    {
+        array_2d_transpose_square(arr, n, n);
+    }
+
+    // In-place transpose of a square n x n array (rows ld elements apart)
+    // with in-register transposes of array_2d_transpose_kernel tiles:
+    // a pair of mirrored tiles is transposed into each other through
+    // a small stack buffer.
+    template<typename T, typename DT>
+    void array_2d_transpose_square_simd(T *arr, DT n, DT ld)
+    {
+        typedef array_2d_transpose_kernel<T> kernel;
+        const DT k = kernel::size;
+        const DT nk = n / k * k;
+        const DT tile = std::max<DT>(k, array_2d_transpose_tile<T>() / k * k);
+        T tmp[kernel::size * kernel::size];
+
+        for (DT ib = 0; ib < nk; ib += tile) {
+            const DT ie = std::min(ib + tile, nk);
+            for (DT jb = ib; jb < nk; jb += tile) {
+                const DT je = std::min(jb + tile, nk);
+                for (DT i = ib; i < ie; i += k) {
+                    for (DT j = (jb == ib) ? i : jb; j < je; j += k) {
+                        T *a = arr + i * ld + j;
+                        T *b = arr + j * ld + i;
+                        kernel::transpose(a, ld, tmp, k);
+                        if (i != j) {
+                            kernel::transpose(b, ld, a, ld);
+                        }
+                        for (DT r = 0; r < k; ++r) {
+                            std::copy(tmp + r * k, tmp + (r + 1) * k,
+                                      b + r * ld);
+                        }
+                    }
+                }
+            }
+        }
+
+        // the last n - nk rows/columns
+        for (DT i = 0; i < n; ++i) {
+            for (DT j = std::max(nk, i + 1); j < n; ++j) {
+                std::swap(arr[i * ld + j], arr[j * ld + i]);
+            }
+        }
+    }
+
+    // In-place transpose of a square n x n array with in-register
+    // transposes (see above)
+    template<typename T, typename DT>
+    void array_2d_transpose_square_simd(T *arr, DT n)
+    {
+        array_2d_transpose_square_simd(arr, n, n);
+    }
+
+    // In-place transpose by following the cycles of the permutation
+    // i -> (n * i) % (n * m - 1). A cycle is processed by its smallest
+    // index (leader), which is found by walking the cycle once more.
+    // The next index is computed by array_2d_mulmod (no division).
+    template<typename RandomIterator, typename DT =
+             typename std::iterator_traits<RandomIterator>::difference_type>
+    void array_2d_transpose_v2(RandomIterator arr, DT n, DT m)
     {
         if (n <= 1 || m <= 1) {
             return;
         }
 
         const DT mn1 = m * n - 1;
+        const array_2d_mulmod next(n, mn1);
         DT cycle = 0, cycle_len, i;
 
         while (++cycle != mn1 - 1) {
@@ -58,7 +365,7 @@ namespace algo
             cycle_len = 0;
             i = cycle;
             do  {
-                i = (n * i) % mn1;
+                i = (DT)next(i);
                 cycle_len++;
             } while (i > cycle);
 
@@ -67,12 +374,495 @@ namespace algo
 
             i = cycle;
             do  {
-                i = (n * i) % mn1;
+                i = (DT)next(i);
                 std::swap(arr[i], arr[cycle]);
             } while (i != cycle);
         }
     }
 
+    // Copy the block of w columns gathered into tmp (row p at tmp + p * w)
+    // back to the columns [c0, c0 + cw) of n x m array arr
+    template<typename RandomIterator, typename VT, typename DT>
+    void array_2d_store_columns(RandomIterator arr, DT n, DT m,
+                                const std::vector<VT> &tmp, DT w,
+                                DT c0, DT cw)
+    {
+        for (DT p = 0; p < n; ++p) {
+            std::copy(tmp.begin() + p * w, tmp.begin() + p * w + cw,
+                      arr + p * m + c0);
+        }
+    }
+
+    // Step 1 of array_2d_transpose_v3() on the columns [j0, j1)
+    // (j0 is a multiple of the block width):
+    // new (p, j) = old ((p + j / b) % n, j)
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_v3_rotate(RandomIterator arr, DT n, DT m,
+                                      DT b, DT j0, DT j1)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        // a cache line of columns, no wider than the range
+        const DT w = std::max<DT>(1, std::min<DT>(64 / sizeof(VT), j1 - j0));
+        std::vector<VT> tmp(n * w);
+        std::vector<DT> si(w);
+
+        for (DT c0 = j0; c0 < j1; c0 += w) {
+            const DT cw = std::min(w, j1 - c0);
+            for (DT k = 0; k < cw; ++k) {
+                si[k] = (c0 + k) / b;
+            }
+            for (DT p = 0; p < n; ++p) {
+                for (DT k = 0; k < cw; ++k) {
+                    tmp[p * w + k] = arr[si[k] * m + c0 + k];
+                    si[k] = (si[k] + 1 == n) ? 0 : si[k] + 1;
+                }
+            }
+            array_2d_store_columns(arr, n, m, tmp, w, c0, cw);
+        }
+    }
+
+    // Step 2 of array_2d_transpose_v3() on the rows [p0, p1): in row p,
+    // column j (original row i) goes to column (j * n + i) % m,
+    // i = (p + j / b) % n
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_v3_rows(RandomIterator arr, DT n, DT m,
+                                    DT b, DT p0, DT p1)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        std::vector<VT> tmp(m);
+
+        const DT nm = n % m;
+        for (DT p = p0; p < p1; ++p) {
+            DT i = p, im = p % m, jn = 0, jr = 0;
+            for (DT j = 0; j < m; ++j) {
+                DT dst = jn + im;
+                tmp[(dst >= m) ? dst - m : dst] = arr[p * m + j];
+
+                jn += nm;
+                jn = (jn >= m) ? jn - m : jn;
+                if (++jr == b) {
+                    jr = 0;
+                    i = (i + 1 == n) ? 0 : i + 1;
+                    im = i % m;
+                }
+            }
+            std::copy(tmp.begin(), tmp.end(), arr + p * m);
+        }
+    }
+
+    // Step 3 of array_2d_transpose_v3() on the columns [j0, j1)
+    // (j0 is a multiple of the block width), as a gather: the element of
+    // row r, column k is the original (i, j) with j * n + i = r * m + k,
+    // which after steps 1 and 2 is in row p = (i - j / b) % n of that
+    // column. Going down a column, r * m + k grows by m, so i grows by
+    // m % n and j by m / n (+1 on carry).
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_v3_columns(RandomIterator arr, DT n, DT m,
+                                       DT b, DT j0, DT j1)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        // a cache line of columns, no wider than the range
+        const DT w = std::max<DT>(1, std::min<DT>(64 / sizeof(VT), j1 - j0));
+        std::vector<VT> tmp(n * w);
+        std::vector<DT> st(w), si(w), sjr(w);
+
+        const DT mn = m % n, mq = m / n;
+        for (DT c0 = j0; c0 < j1; c0 += w) {
+            const DT cw = std::min(w, j1 - c0);
+            for (DT k = 0; k < cw; ++k) {
+                si[k] = (c0 + k) % n;
+                st[k] = ((c0 + k) / n) / b;
+                sjr[k] = ((c0 + k) / n) % b;
+            }
+            for (DT r = 0; r < n; ++r) {
+                for (DT k = 0; k < cw; ++k) {
+                    const DT i = si[k], t = st[k];
+                    const DT p = (i >= t) ? i - t : i + n - t;
+                    tmp[r * w + k] = arr[p * m + c0 + k];
+
+                    DT carry = 0;
+                    si[k] += mn;
+                    if (si[k] >= n) {
+                        si[k] -= n;
+                        carry = 1;
+                    }
+                    sjr[k] += mq + carry;
+                    while (sjr[k] >= b) {
+                        sjr[k] -= b;
+                        st[k]++;
+                    }
+                }
+            }
+            array_2d_store_columns(arr, n, m, tmp, w, c0, cw);
+        }
+    }
+
+    // In-place transpose by decomposition into independent row and column
+    // permutations (Catanzaro, Keller, Garland, "A Decomposition for
+    // In-place Matrix Transposition"). O(N) time, no cycles to follow,
+    // O(max(n, m)) extra memory: n times a cache line of columns (at most
+    // the m columns) for the column steps, m for the row step.
+    //
+    // The n x m array is viewed as n x m during all three steps.
+    // With c = gcd(n, m), b = m / c, the element from (i, j) goes to
+    // linear index j * n + i (the transposed position), via:
+    // 1. column rotation: column j is rotated up by j / b rows
+    //    (no-op if n and m are coprime)
+    // 2. row shuffle: in every row, column j goes to (j * n + i) % m
+    // 3. column shuffle: in every column, the element goes to
+    //    row (j * n + i) / m
+    // The column steps process a cache line worth of columns at a time.
+    // All the indecies are updated incrementally (no division per element)
+    // and stay non-negative, DT may be unsigned.
+    //
+    // Every step permutes rows (or blocks of columns) independently of
+    // each other, so with nthreads > 1 each step is split across threads,
+    // which only meet at the end of the step. Every thread has its own
+    // scratch space; a std::bad_alloc in any of them is rethrown to the
+    // caller once all the threads of the step have finished.
+    template<typename RandomIterator, typename DT =
+             typename std::iterator_traits<RandomIterator>::difference_type>
+    void array_2d_transpose_v3(RandomIterator arr, DT n, DT m,
+                               unsigned nthreads = 1)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+
+        if (n <= 1 || m <= 1) {
+            return;
+        }
+
+        DT c = n, r = m;
+        while (r != 0) {
+            DT t = c % r; c = r; r = t;
+        }
+        const DT b = m / c;
+
+        // columns per block, a cache line of elements
+        const DT w = std::max<DT>(1, 64 / sizeof(VT));
+        const DT blocks = (m + w - 1) / w;
+
+        if (c > 1) {
+            parallel_for_ranges(blocks, (DT)1, nthreads,
+                                [ & ] (DT k0, DT k1) {
+                    array_2d_transpose_v3_rotate(arr, n, m, b, k0 * w,
+                                                 std::min(k1 * w, m));
+                });
+        }
+        parallel_for_ranges(n, (DT)1, nthreads, [ & ] (DT p0, DT p1) {
+                array_2d_transpose_v3_rows(arr, n, m, b, p0, p1);
+            });
+        parallel_for_ranges(blocks, (DT)1, nthreads, [ & ] (DT k0, DT k1) {
+                array_2d_transpose_v3_columns(arr, n, m, b, k0 * w,
+                                              std::min(k1 * w, m));
+            });
+    }
+
+    // Rectangular in-place transpose: the row/column decomposition if the
+    // elements can be copied to its scratch space, the cycles otherwise
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_rect(RandomIterator arr, DT n, DT m,
+                                 std::true_type)
+    {
+        array_2d_transpose_v3(arr, n, m);
+    }
+
+    template<typename RandomIterator, typename DT>
+    void array_2d_transpose_rect(RandomIterator arr, DT n, DT m,
+                                 std::false_type)
+    {
+        array_2d_transpose_v2(arr, n, m);
+    }
+
+    // In-place transpose of n x m array: square arrays swap mirrored
+    // elements, rectangular ones use the row/column decomposition
+    // (array_2d_transpose_v3), which allocates O(max(n, m)) elements of
+    // scratch space (n times min(m, a cache line of columns)) and may
+    // throw std::bad_alloc. Elements that are not default-constructible and
+    // copyable (e.g. move-only) fall back to array_2d_transpose_v2, which
+    // only swaps them, with no allocation.
+    template<typename RandomIterator, typename DT =
+             typename std::iterator_traits<RandomIterator>::difference_type>
+    void array_2d_transpose(RandomIterator arr, DT n, DT m)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+
+        if (n == m) {
+            array_2d_transpose_square(arr, n);
+        } else {
+            array_2d_transpose_rect(arr, n, m, std::integral_constant<bool,
+                std::is_default_constructible<VT>::value &&
+                std::is_copy_assignable<VT>::value>());
+        }
+    }
+
+    // Multithreaded in-place transpose of n x m array on nthreads threads
+    // (all hardware threads by default). Square arrays split the bands of
+    // tiles above the diagonal (interleaved, as the bands get shorter
+    // towards the bottom), rectangular ones run every step of
+    // array_2d_transpose_v3() in parallel.
+    template<typename RandomIterator, typename DT =
+             typename std::iterator_traits<RandomIterator>::difference_type>
+    void array_2d_transpose_parallel(RandomIterator arr, DT n, DT m,
+                                     unsigned nthreads = 0)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+
+        if (nthreads == 0) {
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        if (n != m) {
+            array_2d_transpose_v3(arr, n, m, nthreads);
+            return;
+        }
+
+        const DT tile = std::max<DT>(1, array_2d_transpose_tile<VT>());
+        const DT bands = (n + tile - 1) / tile;
+        const DT nt = std::min<DT>(nthreads, bands);
+        parallel_for_ranges(nt, (DT)1, (unsigned)nt, [ & ] (DT t, DT) {
+                for (DT ib = t * tile; ib < n; ib += nt * tile) {
+                    const DT ie = std::min(ib + tile, n);
+                    for (DT jb = ib; jb < n; jb += tile) {
+                        const DT je = std::min(jb + tile, n);
+                        for (DT i = ib; i < ie; ++i) {
+                            for (DT j = std::max(jb, i + 1); j < je; ++j) {
+                                std::swap(arr[i * n + j], arr[j * n + i]);
+                            }
+                        }
+                    }
+                }
+            });
+    }
+
+    // Cycle structure of the in-place transpose of n x m arrays, computed
+    // once and applied to any number of them (many small matrices of the
+    // same shape). Every cycle of the permutation i -> (n * i) % (n * m - 1)
+    // is stored as its leader followed by the rest of the cycle in walking
+    // order, so applying it is the same swaps as array_2d_transpose_v2()
+    // without the search for the leaders. O(n * m) memory.
+    // Square arrays need no cycles, they are transposed by mirror swaps.
+    template<typename DT = std::ptrdiff_t>
+    class array_2d_transpose_plan
+    {
+    public:
+        array_2d_transpose_plan(DT n, DT m)
+            : n_(n), m_(m)
+        {
+            if (n <= 1 || m <= 1 || n == m) {
+                return;
+            }
+
+            const DT mn1 = m * n - 1;
+            const array_2d_mulmod next(n, mn1);
+            std::vector<bool> visited(n * m, false);
+
+            for (DT cycle = 1; cycle < mn1; ++cycle) {
+                if (visited[cycle]) {
+                    continue;
+                }
+                DT i = (DT)next(cycle);
+                if (i == cycle) {
+                    continue;
+                }
+                starts_.push_back(cycles_.size());
+                cycles_.push_back(cycle);
+                for (; i != cycle; i = (DT)next(i)) {
+                    cycles_.push_back(i);
+                    visited[i] = true;
+                }
+            }
+            starts_.push_back(cycles_.size());
+        }
+
+        // @return value - number of rows of the arrays to transpose
+        DT rows() const { return n_; }
+
+        // @return value - number of columns of the arrays to transpose
+        DT cols() const { return m_; }
+
+        // @brief  In-place transpose of n x m array arr
+        template<typename RandomIterator>
+        void transpose(RandomIterator arr) const
+        {
+            typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+
+            if (n_ == m_) {
+                array_2d_transpose_square(arr, n_);
+                return;
+            }
+
+            for (size_t c = 0; c + 1 < starts_.size(); ++c) {
+                const DT *cyc = cycles_.data() + starts_[c];
+                const DT *end = cycles_.data() + starts_[c + 1];
+                VT t = std::move(arr[cyc[0]]);
+                for (++cyc; cyc != end; ++cyc) {
+                    std::swap(arr[*cyc], t);
+                }
+                arr[cycles_[starts_[c]]] = std::move(t);
+            }
+        }
+
+    private:
+        DT n_, m_;
+        std::vector<DT> cycles_;
+        std::vector<size_t> starts_;
+    };
+
+    // In-place transpose of count n x m arrays stored back to back
+    // (matrix k starts at arr + k * n * m). The cycle structure is computed
+    // once (array_2d_transpose_plan), the matrices are split across
+    // nthreads threads.
+    template<typename RandomIterator, typename DT =
+             typename std::iterator_traits<RandomIterator>::difference_type>
+    void array_2d_transpose_batch(RandomIterator arr, DT n, DT m, DT count,
+                                  unsigned nthreads = 1)
+    {
+        const array_2d_transpose_plan<DT> plan(n, m);
+        const DT nm = n * m;
+        parallel_for_ranges(count, (DT)1, nthreads, [ & ] (DT k0, DT k1) {
+                for (DT k = k0; k < k1; ++k) {
+                    plan.transpose(arr + k * nm);
+                }
+            });
+    }
+
+    // Recursive (cache-oblivious) out-of-place transpose of the
+    // submatrix [i0,i1) x [j0,j1) of array src (rows lds elements apart)
+    // into array dst (rows ldd elements apart).
+    // The longer side is halved until the block is small enough to fit
+    // into any cache level, no matter what the cache sizes are.
+    template<typename RandomIterator1, typename RandomIterator2, typename DT>
+    void array_2d_transpose_recursive(RandomIterator1 src, DT lds,
+                                      RandomIterator2 dst, DT ldd,
+                                      DT i0, DT i1, DT j0, DT j1)
+    {
+        const DT leaf = 16;
+
+        while (i1 - i0 > leaf || j1 - j0 > leaf) {
+            if (i1 - i0 >= j1 - j0) {
+                DT im = i0 + (i1 - i0) / 2;
+                array_2d_transpose_recursive(src, lds, dst, ldd,
+                                             i0, im, j0, j1);
+                i0 = im;
+            } else {
+                DT jm = j0 + (j1 - j0) / 2;
+                array_2d_transpose_recursive(src, lds, dst, ldd,
+                                             i0, i1, j0, jm);
+                j0 = jm;
+            }
+        }
+
+        for (DT i = i0; i < i1; ++i) {
+            for (DT j = j0; j < j1; ++j) {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+    }
+
+    // Recursive (cache-oblivious) out-of-place transpose
+    // of n x m array src into m x n array dst
+    template<typename RandomIterator1, typename RandomIterator2, typename DT =
+             typename std::iterator_traits<RandomIterator1>::difference_type>
+    void array_2d_transpose_recursive(RandomIterator1 src, RandomIterator2 dst,
+                                      DT n, DT m)
+    {
+        array_2d_transpose_recursive(src, m, dst, n, (DT)0, n, (DT)0, m);
+    }
+
+    // Blocked out-of-place transpose of n x m array src (rows lds elements
+    // apart) into m x n array dst (rows ldd elements apart), so that
+    // sub-matrices of larger arrays are transposed without copying.
+    // src and dst must not overlap.
+    //
+    // The matrix is walked tile by tile, with tiles sized to L1, so both
+    // the rows read from src and the columns written to dst stay in cache
+    // while a tile is transposed: every cache line is loaded once instead of
+    // once per element. Element types too large for a useful tile fall back
+    // to the recursive cache-oblivious version.
+    template<typename RandomIterator1, typename RandomIterator2, typename DT>
+    void array_2d_transpose_blocked(RandomIterator1 src, DT lds,
+                                    RandomIterator2 dst, DT ldd,
+                                    DT n, DT m)
+    {
+        typedef typename std::iterator_traits<RandomIterator1>::value_type VT;
+        const DT tile = array_2d_transpose_tile<VT>();
+
+        if (tile < 8) {
+            array_2d_transpose_recursive(src, lds, dst, ldd,
+                                         (DT)0, n, (DT)0, m);
+            return;
+        }
+
+        for (DT ib = 0; ib < n; ib += tile) {
+            const DT ie = std::min(ib + tile, n);
+            for (DT jb = 0; jb < m; jb += tile) {
+                const DT je = std::min(jb + tile, m);
+                for (DT i = ib; i < ie; ++i) {
+                    for (DT j = jb; j < je; ++j) {
+                        dst[j * ldd + i] = src[i * lds + j];
+                    }
+                }
+            }
+        }
+    }
+
+    // Blocked out-of-place transpose of n x m array src into m x n array dst
+    template<typename RandomIterator1, typename RandomIterator2, typename DT =
+             typename std::iterator_traits<RandomIterator1>::difference_type>
+    void array_2d_transpose_blocked(RandomIterator1 src, RandomIterator2 dst,
+                                    DT n, DT m)
+    {
+        array_2d_transpose_blocked(src, m, dst, n, n, m);
+    }
+
+    // Blocked out-of-place transpose of n x m array src (rows lds elements
+    // apart) into m x n array dst (rows ldd elements apart) with
+    // in-register transposes (array_2d_transpose_kernel) as the leaves
+    // of the L1 tiles. src and dst must not overlap.
+    template<typename T, typename DT>
+    void array_2d_transpose_simd(const T *src, DT lds, T *dst, DT ldd,
+                                 DT n, DT m)
+    {
+        typedef array_2d_transpose_kernel<T> kernel;
+        const DT k = kernel::size;
+        const DT nk = n / k * k;
+        const DT mk = m / k * k;
+        const DT tile = std::max<DT>(k, array_2d_transpose_tile<T>() / k * k);
+
+        for (DT ib = 0; ib < nk; ib += tile) {
+            const DT ie = std::min(ib + tile, nk);
+            for (DT jb = 0; jb < mk; jb += tile) {
+                const DT je = std::min(jb + tile, mk);
+                for (DT j = jb; j < je; j += k) {
+                    for (DT i = ib; i < ie; i += k) {
+                        kernel::transpose(src + i * lds + j, lds,
+                                          dst + j * ldd + i, ldd);
+                    }
+                }
+            }
+        }
+
+        // the last m - mk columns and the last n - nk rows
+        for (DT i = 0; i < nk; ++i) {
+            for (DT j = mk; j < m; ++j) {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+        for (DT i = nk; i < n; ++i) {
+            for (DT j = 0; j < m; ++j) {
+                dst[j * ldd + i] = src[i * lds + j];
+            }
+        }
+    }
+
+    // Blocked out-of-place transpose of n x m array src into m x n array dst
+    // with in-register transposes (see above)
+    template<typename T, typename DT>
+    void array_2d_transpose_simd(const T *src, T *dst, DT n, DT m)
+    {
+        array_2d_transpose_simd(src, m, dst, n, n, m);
+    }
+
 }
 
 #endif
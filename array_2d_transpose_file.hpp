@@ -0,0 +1,139 @@
+/*******************************************************************************
+ * File   : array_2d_transpose_file.hpp
+ * Brief  : Out-of-core transpose of 2D arrays stored in files
+ *
+ * Author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+ *
+ *******************************************************************************
+ */
+#ifndef ARRAY_2D_TRANSPOSE_FILE_HPP
+#define ARRAY_2D_TRANSPOSE_FILE_HPP
+
+#include <unistd.h>    // pread(), pwrite()
+#include <errno.h>
+#include <sys/types.h> // off_t
+#include <cmath>       // std::sqrt()
+#include <vector>
+#include <algorithm>   // std::min(), std::max()
+
+#include "array_2d_transpose.hpp"
+
+namespace algo
+{
+    // Default memory budget of array_2d_transpose_file()
+    const size_t array_2d_file_budget = 256 * 1024 * 1024;
+
+    // pread() exactly len bytes at offset off (restarting on short reads
+    // and EINTR); false on error or end of file
+    inline bool array_2d_pread(int fd, void *buf, size_t len, off_t off)
+    {
+        char *p = static_cast<char*>(buf);
+        while (len > 0) {
+            ssize_t r = pread(fd, p, len, off);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                if (r == 0) {
+                    errno = EIO;
+                }
+                return false;
+            }
+            p += r; len -= r; off += r;
+        }
+        return true;
+    }
+
+    // pwrite() exactly len bytes at offset off (restarting on short writes
+    // and EINTR); false on error
+    inline bool array_2d_pwrite(int fd, const void *buf, size_t len, off_t off)
+    {
+        const char *p = static_cast<const char*>(buf);
+        while (len > 0) {
+            ssize_t r = pwrite(fd, p, len, off);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r < 0) {
+                return false;
+            }
+            p += r; len -= r; off += r;
+        }
+        return true;
+    }
+
+    // Out-of-core transpose of n x m array of T stored row-major in file src
+    // into m x n array in file dst (same convention as array_2d_transpose),
+    // for arrays larger than the memory. At most budget bytes are used.
+    //
+    // The array is processed in tiles: a tile is read, transposed in memory
+    // by array_2d_transpose_blocked() and written out, so every byte is read
+    // once and written once (a single pass over both files). The tiles are
+    // as close to square as the budget allows, but span whole rows of src
+    // (one read per tile) when the array is narrow, or whole rows of dst
+    // (one write per tile) when it is short; otherwise every row of a tile
+    // is a separate pread()/pwrite() of tile-width bytes.
+    //
+    // @return value - false on I/O error (errno is set), true otherwise
+    template<typename T, typename DT>
+    bool array_2d_transpose_file(int src, int dst, DT n, DT m,
+                                 size_t budget = array_2d_file_budget)
+    {
+        if (n == 0 || m == 0) {
+            return true;
+        }
+
+        // elements per buffer: a tile is read into one and transposed
+        // into the other
+        const DT e = std::max<DT>(1, budget / (2 * sizeof(T)));
+        const DT t = std::max<DT>(1, (DT)std::sqrt((double)e));
+        const DT tw = std::min(m, std::max<DT>(1, e / std::min(n, t)));
+        const DT th = std::min(n, std::max<DT>(1, e / tw));
+
+        std::vector<T> in(th * tw), out(th * tw);
+        const off_t es = sizeof(T);
+
+        for (DT i0 = 0; i0 < n; i0 += th) {
+            const DT h = std::min(th, n - i0);
+            for (DT j0 = 0; j0 < m; j0 += tw) {
+                const DT w = std::min(tw, m - j0);
+
+                // h x w tile at (i0, j0) of src
+                if (w == m) {
+                    if (!array_2d_pread(src, in.data(), h * w * es,
+                                        (off_t)i0 * m * es)) {
+                        return false;
+                    }
+                } else {
+                    for (DT i = 0; i < h; ++i) {
+                        if (!array_2d_pread(src, in.data() + i * w, w * es,
+                                            ((off_t)(i0 + i) * m + j0) * es)) {
+                            return false;
+                        }
+                    }
+                }
+
+                array_2d_transpose_blocked(in.data(), w, out.data(), h, h, w);
+
+                // w x h tile at (j0, i0) of dst
+                if (h == n) {
+                    if (!array_2d_pwrite(dst, out.data(), h * w * es,
+                                         (off_t)j0 * n * es)) {
+                        return false;
+                    }
+                } else {
+                    for (DT j = 0; j < w; ++j) {
+                        if (!array_2d_pwrite(dst, out.data() + j * h, h * es,
+                                             ((off_t)(j0 + j) * n + i0) * es)) {
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+}
+
+#endif
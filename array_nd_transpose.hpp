@@ -0,0 +1,320 @@
+/*******************************************************************************
+ * File   : array_nd_transpose.hpp
+ * Brief  : Permute the axes of N-dimensional arrays (inplace and out-of-place)
+ *
+ * Author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+ *
+ *******************************************************************************
+ */
+#ifndef ARRAY_ND_TRANSPOSE_HPP
+#define ARRAY_ND_TRANSPOSE_HPP
+
+#include <cassert>
+#include <iterator>
+#include <vector>
+#include <algorithm> // std::copy(), std::move()
+#include <numeric>   // std::accumulate()
+#include <functional>
+
+#include "array_2d_transpose.hpp"
+
+namespace algo
+{
+    // N-dimensional arrays are row-major: dims[0] is the slowest axis,
+    // dims[r - 1] the fastest. A permutation perm gives the axes of the
+    // result: axis k of the result is axis perm[k] of the source, so
+    // the result has dims[perm[0]] x ... x dims[perm[r - 1]] elements
+    // (the numpy.transpose convention). E.g. NCHW -> NHWC is
+    // perm = { 0, 2, 3, 1 }.
+
+    // Reduces dims and perm to the smallest equivalent permutation:
+    // axes of size 1 are dropped, and axes that stay next to each other
+    // in the same order are merged into one. NCHW -> NHWC becomes
+    // N x C x HW with perm { 0, 2, 1 }, i.e. a batch of 2D transposes.
+    // The result is empty if no elements move at all.
+    template<typename DT>
+    void array_nd_collapse(const std::vector<DT> &dims,
+                           const std::vector<DT> &perm,
+                           std::vector<DT> &cdims, std::vector<DT> &cperm)
+    {
+        const DT r = dims.size();
+        assert(perm.size() == dims.size());
+
+        // source axes of size > 1, renumbered without the others
+        std::vector<DT> renum(r, 0);
+        DT kept = 0;
+        for (DT k = 0; k < r; ++k) {
+            renum[k] = kept;
+            kept += (dims[k] != 1);
+        }
+
+        // groups of consecutive source axes, in the result order:
+        // (first source axis, number of elements)
+        std::vector<DT> first, size;
+        DT prev = 0;
+        for (DT k = 0; k < r; ++k) {
+            assert(perm[k] < r);
+            const DT a = perm[k];
+            if (dims[a] == 1) {
+                continue;
+            }
+            if (!first.empty() && renum[a] == prev + 1) {
+                size.back() *= dims[a];
+            } else {
+                first.push_back(renum[a]);
+                size.push_back(dims[a]);
+            }
+            prev = renum[a];
+        }
+
+        // the source axes of the collapsed array are the groups ordered
+        // by their first source axis
+        const DT g = first.size();
+        std::vector<DT> order(g);
+        for (DT i = 0; i < g; ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(),
+                  [ & ] (DT a, DT b) { return first[a] < first[b]; });
+
+        cdims.assign(g, 0);
+        cperm.assign(g, 0);
+        for (DT i = 0; i < g; ++i) {
+            cdims[i] = size[order[i]];
+            cperm[order[i]] = i;
+        }
+
+        bool identity = true;
+        for (DT i = 0; i < g; ++i) {
+            identity = identity && (cperm[i] == i);
+        }
+        if (identity) {
+            cdims.clear();
+            cperm.clear();
+        }
+    }
+
+    // Row-major strides of an array with the given dims
+    template<typename DT>
+    std::vector<DT> array_nd_strides(const std::vector<DT> &dims)
+    {
+        std::vector<DT> strides(dims.size(), 1);
+        for (DT k = dims.size(); k-- > 1; ) {
+            strides[k - 1] = strides[k] * dims[k];
+        }
+        return strides;
+    }
+
+    // Calls func(src_offset, dst_offset) for every combination of the
+    // indecies along the result axes axes (the other axes are 0), where
+    // src_offset and dst_offset are the offsets of that element in the
+    // source and the result. The offsets are updated incrementally.
+    // Nothing is called if any of the axes is empty.
+    template<typename DT, typename Func>
+    void array_nd_for_each(const std::vector<DT> &odims,
+                           const std::vector<DT> &sstrides,
+                           const std::vector<DT> &dstrides,
+                           const std::vector<DT> &axes, Func func)
+    {
+        const DT na = axes.size();
+        for (DT k = 0; k < na; ++k) {
+            if (odims[axes[k]] == 0) {
+                return;
+            }
+        }
+        std::vector<DT> idx(na, 0);
+        DT so = 0, d = 0;
+
+        while (true) {
+            func(so, d);
+
+            // odometer, the last axis is the fastest
+            DT k = na;
+            while (k > 0) {
+                const DT a = axes[k - 1];
+                if (++idx[k - 1] < odims[a]) {
+                    so += sstrides[a];
+                    d += dstrides[a];
+                    break;
+                }
+                so -= (odims[a] - 1) * sstrides[a];
+                d -= (odims[a] - 1) * dstrides[a];
+                idx[k - 1] = 0;
+                --k;
+            }
+            if (k == 0) {
+                return;
+            }
+        }
+    }
+
+    // Out-of-place axis permutation of array src with dimensions dims into
+    // array dst (src and dst must not overlap).
+    //
+    // After array_nd_collapse(), either the fastest axis stays the fastest
+    // one, and contiguous runs are copied, or every 2D slice spanned by the
+    // fastest source axis and the fastest result axis is transposed by the
+    // strided blocked array_2d_transpose_blocked() (so a plain matrix
+    // transpose is a single call, and NCHW -> NHWC is N of them).
+    template<typename RandomIterator1, typename RandomIterator2, typename DT>
+    void array_nd_transpose(RandomIterator1 src, RandomIterator2 dst,
+                            const std::vector<DT> &dims,
+                            const std::vector<DT> &perm)
+    {
+        const DT total = std::accumulate(dims.begin(), dims.end(), (DT)1,
+                                         std::multiplies<DT>());
+        if (total == 0) {
+            return;
+        }
+        std::vector<DT> d, p;
+        array_nd_collapse(dims, perm, d, p);
+        if (d.empty()) {
+            std::copy(src, src + total, dst);
+            return;
+        }
+
+        const DT r = d.size();
+        std::vector<DT> od(r), ss(r);
+        const std::vector<DT> is = array_nd_strides(d);
+        for (DT k = 0; k < r; ++k) {
+            od[k] = d[p[k]];
+            ss[k] = is[p[k]];  // source stride along result axis k
+        }
+        const std::vector<DT> os = array_nd_strides(od);
+
+        if (p[r - 1] == r - 1) {
+            // runs of the fastest axis are contiguous in both arrays
+            const DT run = d[r - 1];
+            std::vector<DT> axes;
+            for (DT k = 0; k + 1 < r; ++k) {
+                axes.push_back(k);
+            }
+            array_nd_for_each(od, ss, os, axes, [ & ] (DT so, DT o) {
+                    std::copy(src + so, src + so + run, dst + o);
+                });
+            return;
+        }
+
+        // a: source axis that becomes the fastest result axis,
+        // q: result axis that is the fastest source axis
+        const DT a = p[r - 1];
+        const DT q = std::find(p.begin(), p.end(), r - 1) - p.begin();
+        std::vector<DT> axes;
+        for (DT k = 0; k + 1 < r; ++k) {
+            if (k != q) {
+                axes.push_back(k);
+            }
+        }
+        array_nd_for_each(od, ss, os, axes, [ & ] (DT so, DT o) {
+                array_2d_transpose_blocked(src + so, is[a], dst + o, os[q],
+                                           d[a], d[r - 1]);
+            });
+    }
+
+    // In-place permutation of the collapsed array (see below)
+    template<typename RandomIterator, typename DT>
+    void array_nd_transpose_collapsed(RandomIterator arr,
+                                      const std::vector<DT> &d,
+                                      const std::vector<DT> &p)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        const DT r = d.size();
+
+        if (r == 2) {
+            array_2d_transpose(arr, d[0], d[1]);
+            return;
+        }
+
+        if (p[0] == 0) {
+            // the slowest axis stays: every slice is permuted on its own,
+            // a batch of 2D transposes in the 3D case
+            const std::vector<DT> sd(d.begin() + 1, d.end());
+            std::vector<DT> sp(p.begin() + 1, p.end());
+            for (DT &x : sp) {
+                --x;
+            }
+            const DT slice = std::accumulate(sd.begin(), sd.end(), (DT)1,
+                                             std::multiplies<DT>());
+            if (r == 3 && slice <= (DT)4096) {
+                array_2d_transpose_batch(arr, d[1], d[2], d[0]);
+                return;
+            }
+            for (DT k = 0; k < d[0]; ++k) {
+                array_nd_transpose_collapsed(arr + k * slice, sd, sp);
+            }
+            return;
+        }
+
+        // follow the cycles of the permutation of units: single elements,
+        // or contiguous runs if the fastest axis stays the fastest
+        const DT run = (p[r - 1] == r - 1) ? d[r - 1] : 1;
+        const DT ur = (run > 1) ? r - 1 : r;
+        std::vector<DT> od(ur), ss(ur);
+        const std::vector<DT> ud(d.begin(), d.begin() + ur);
+        const std::vector<DT> is = array_nd_strides(ud);
+        for (DT k = 0; k < ur; ++k) {
+            od[k] = d[p[k]];
+            ss[k] = is[p[k]];
+        }
+        const DT units = std::accumulate(ud.begin(), ud.end(), (DT)1,
+                                         std::multiplies<DT>());
+
+        // source unit of result unit o: the mixed radix digits of o in
+        // the result dims, times the source strides
+        auto source = [ & ] (DT o) {
+            DT s = 0;
+            for (DT k = ur; k-- > 0; ) {
+                s += (o % od[k]) * ss[k];
+                o /= od[k];
+            }
+            return s;
+        };
+
+        std::vector<bool> visited(units, false);
+        std::vector<VT> tmp(run);
+        for (DT c = 0; c < units; ++c) {
+            if (visited[c]) {
+                continue;
+            }
+            DT s = source(c);
+            if (s == c) {
+                continue;
+            }
+            std::move(arr + c * run, arr + (c + 1) * run, tmp.begin());
+            DT cur = c;
+            while (s != c) {
+                std::move(arr + s * run, arr + (s + 1) * run, arr + cur * run);
+                visited[cur] = true;
+                cur = s;
+                s = source(cur);
+            }
+            std::move(tmp.begin(), tmp.end(), arr + cur * run);
+            visited[cur] = true;
+        }
+    }
+
+    // In-place axis permutation of array arr with dimensions dims.
+    //
+    // After array_nd_collapse(), a plain matrix transpose goes to
+    // array_2d_transpose(), a permutation that keeps the slowest axis is
+    // done slice by slice (small 3D slices, e.g. NCHW -> NHWC, as one
+    // array_2d_transpose_batch()), anything else follows the cycles of the
+    // permutation (mixed radix), moving whole runs if the fastest axis
+    // stays, with a bitmap of visited elements (O(N) bits).
+    template<typename RandomIterator, typename DT>
+    void array_nd_transpose(RandomIterator arr, const std::vector<DT> &dims,
+                            const std::vector<DT> &perm)
+    {
+        if (std::find(dims.begin(), dims.end(), (DT)0) != dims.end()) {
+            return;
+        }
+        std::vector<DT> d, p;
+        array_nd_collapse(dims, perm, d, p);
+        if (!d.empty()) {
+            array_nd_transpose_collapsed(arr, d, p);
+        }
+    }
+
+}
+
+#endif
@@ -9,9 +9,13 @@
 #ifndef ALGO_BINARY_TREE_HPP
 #define ALGO_BINARY_TREE_HPP
 
-#include <map>
-#include <stack>
 #include <queue>
+#include <vector>
+#include <utility>      // std::pair, std::forward
+#include <iterator>     // std::forward_iterator_tag
+#include <cstddef>      // std::ptrdiff_t
+#include <new>          // placement new
+#include <type_traits>  // std::is_trivially_destructible
 #include <stdlib.h>  // rand()
 
 #include <algorithm>
@@ -33,21 +37,269 @@ struct binary_tree_node
     struct binary_tree_node *right;
 };
 
+template<typename T>
+struct binary_tree_avl_node
+{
+    using data_type = T;
+    data_type data;
+    struct binary_tree_avl_node *left;
+    struct binary_tree_avl_node *right;
+    int height;  // of the subtree, 1 for a leaf
+};
+
+template<typename T>
+struct binary_tree_os_node
+{
+    using data_type = T;
+    data_type data;
+    struct binary_tree_os_node *left;
+    struct binary_tree_os_node *right;
+    int height;   // of the subtree, 1 for a leaf
+    size_t size;  // number of nodes in the subtree
+};
+
+// maximum height of an AVL tree that fits in memory (< 1.45 * log2(n + 2))
+const int binary_tree_avl_max_height = 96;
+
 /// ----------------------------------------------------------------------------
-/// @brief Creates a new node of a binary tree. Allocates memory.
+/// @brief Stack of the iterative traversals with a small inline buffer: the
+///        first N elements live inside the object (on the call stack), the
+///        heap is used only if the tree is deeper than that. A balanced tree
+///        of any size that fits in memory never leaves the inline buffer.
+template <typename T, size_t N = 64>
+class binary_tree_stack
+{
+public:
+    binary_tree_stack() : data_(inline_), size_(0), capacity_(N) { }
+
+    ~binary_tree_stack()
+    {
+        if (data_ != inline_) {
+            delete[] data_;
+        }
+    }
+
+    // a copy takes only the elements in use
+    binary_tree_stack(const binary_tree_stack& other)
+        : data_(inline_), size_(0), capacity_(N)
+    {
+        *this = other;
+    }
+
+    binary_tree_stack& operator=(const binary_tree_stack& other)
+    {
+        if (this != &other) {
+            size_ = 0;
+            while (capacity_ < other.size_) {
+                grow();
+            }
+            std::copy(other.data_, other.data_ + other.size_, data_);
+            size_ = other.size_;
+        }
+        return *this;
+    }
+
+    void push(const T& value)
+    {
+        if (size_ == capacity_) {
+            grow();
+        }
+        data_[size_++] = value;
+    }
+
+    void pop() { --size_; }
+    T& top() { return data_[size_ - 1]; }
+    const T& top() const { return data_[size_ - 1]; }
+    bool empty() const { return size_ == 0; }
+    size_t size() const { return size_; }
+
+private:
+    void grow()
+    {
+        T* data = new T[2 * capacity_];
+        std::copy(data_, data_ + size_, data);
+        if (data_ != inline_) {
+            delete[] data_;
+        }
+        data_ = data;
+        capacity_ *= 2;
+    }
+
+    T inline_[N];
+    T* data_;
+    size_t size_;
+    size_t capacity_;
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Calls a visitor of a traversal. A visitor may return bool to
+///        control the traversal: false stops it right away. Visitors
+///        returning void or anything else (e.g. a count) never stop it.
+///
+/// @param[in]  visit  visitor callback
+/// @param[in]  args   arguments of the visitor (the node)
+/// @return            false if the traversal has to stop, true otherwise
+template <typename Visitor, typename... Args>
+bool
+binary_tree_visit_impl(std::true_type, Visitor& visit, Args&&... args)
+{
+    return visit(std::forward<Args>(args)...);
+}
+
+template <typename Visitor, typename... Args>
+bool
+binary_tree_visit_impl(std::false_type, Visitor& visit, Args&&... args)
+{
+    visit(std::forward<Args>(args)...);
+    return true;
+}
+
+template <typename Visitor, typename... Args>
+bool
+binary_tree_visit(Visitor& visit, Args&&... args)
+{
+    typedef decltype(visit(std::forward<Args>(args)...)) result;
+    return binary_tree_visit_impl(std::is_same<result, bool>(), visit,
+                                  std::forward<Args>(args)...);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Node allocator that creates every node with new and destroys it
+///        with delete. The default for all functions creating nodes.
+///
+/// An allocator of binary tree nodes provides node_type, allocate() (returns
+/// a value-initialized node), deallocate(node) and reserve(n) (a hint that
+/// n nodes are about to be allocated).
+template <typename TreeNode>
+struct binary_tree_heap_allocator
+{
+    using node_type = TreeNode;
+
+    TreeNode* allocate() { return new TreeNode(); }
+    void deallocate(TreeNode* node) { delete node; }
+    void reserve(size_t) { }
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Arena of binary tree nodes. Nodes are carved from contiguous slabs
+///        (no malloc per node, nodes allocated one after another are next
+///        to each other in memory), deallocated nodes are reused, and all
+///        the nodes are released at once by release() or the destructor,
+///        without walking the tree.
+template <typename TreeNode>
+class binary_tree_node_pool
+{
+public:
+    using node_type = TreeNode;
+
+    /// @param[in]  slab_nodes  [opt] number of nodes per slab
+    explicit binary_tree_node_pool(size_t slab_nodes = 4096)
+        : slab_nodes_(slab_nodes ? slab_nodes : 1), nodes_(0) { }
+
+    ~binary_tree_node_pool() { release(); }
+
+    binary_tree_node_pool(const binary_tree_node_pool&) = delete;
+    binary_tree_node_pool& operator=(const binary_tree_node_pool&) = delete;
+
+    /// @return  a value-initialized node
+    TreeNode* allocate()
+    {
+        if (!free_.empty()) {
+            TreeNode* node = free_.back();
+            free_.pop_back();
+            return node;
+        }
+        if (slabs_.empty() || slabs_.back().used == slabs_.back().size) {
+            add_slab(slab_nodes_);
+        }
+        slab& last = slabs_.back();
+        nodes_++;
+        return new (last.nodes + last.used++) TreeNode();
+    }
+
+    /// @brief Returns a node to the pool for reuse. Every slot in the slabs
+    ///        always holds a constructed node, so a deallocated node is
+    ///        reset to a value-initialized one right away.
+    void deallocate(TreeNode* node)
+    {
+        node->~TreeNode();
+        new (node) TreeNode();
+        free_.push_back(node);
+    }
+
+    /// @brief Makes the next n nodes carved from the slabs (the deallocated
+    ///        ones are reused first) consecutive in one block: starts a new
+    ///        slab of at least n nodes if the last one has less room left.
+    ///
+    /// @param[in]  n  number of nodes
+    void reserve(size_t n)
+    {
+        if (n > free_.size()) {
+            n -= free_.size();
+            if (slabs_.empty() || slabs_.back().size - slabs_.back().used < n) {
+                add_slab(std::max(n, slab_nodes_));
+            }
+        }
+    }
+
+    /// @brief Destroys all the nodes and frees the memory at once
+    void release()
+    {
+        for (slab& s : slabs_) {
+            if (!std::is_trivially_destructible<TreeNode>::value) {
+                for (size_t k = 0; k < s.used; k++) {
+                    s.nodes[k].~TreeNode();
+                }
+            }
+            ::operator delete(s.nodes);
+        }
+        slabs_.clear();
+        free_.clear();
+        nodes_ = 0;
+    }
+
+    /// @return  number of nodes in use
+    size_t size() const { return nodes_ - free_.size(); }
+
+private:
+    struct slab
+    {
+        TreeNode* nodes;
+        size_t size;
+        size_t used;                // nodes constructed so far
+    };
+
+    void add_slab(size_t size)
+    {
+        slab s = { static_cast<TreeNode*>(
+                       ::operator new(size * sizeof(TreeNode))), size, 0 };
+        slabs_.push_back(s);
+    }
+
+    size_t slab_nodes_;
+    size_t nodes_;                  // nodes constructed in all the slabs
+    std::vector<slab> slabs_;
+    std::vector<TreeNode*> free_;   // deallocated nodes
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Creates a new node of a binary tree with a given allocator.
 ///
+/// @param[in]  alloc            node allocator (e.g. binary_tree_node_pool)
 /// @param[in]  value            date value for the newly created node
 /// @param[in]  date,left,right  [opt] pointers to data,left,right members
 /// @return                      a newly created node
-template <typename TreeNode,
+template <typename Allocator,
+          typename TreeNode = typename Allocator::node_type,
           typename DataType = typename TreeNode::data_type>
 TreeNode*
-binary_tree_new_node(DataType value = DataType(),
+binary_tree_new_node(Allocator &alloc,
+                     DataType value = DataType(),
                      DataType  TreeNode::* data  = &TreeNode::data,
                      TreeNode* TreeNode::* left  = &TreeNode::left,
                      TreeNode* TreeNode::* right = &TreeNode::right)
 {
-    TreeNode *newnode = new TreeNode();
+    TreeNode *newnode = alloc.allocate();
     newnode->*data  = value;
     newnode->*left  = nullptr;
     newnode->*right = nullptr;
@@ -55,6 +307,42 @@ binary_tree_new_node(DataType value = DataType(),
     return newnode;
 }
 
+/// ----------------------------------------------------------------------------
+/// @brief Creates a new node of a binary tree. Allocates memory.
+///
+/// @param[in]  value            date value for the newly created node
+/// @param[in]  date,left,right  [opt] pointers to data,left,right members
+/// @return                      a newly created node
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type>
+TreeNode*
+binary_tree_new_node(DataType value = DataType(),
+                     DataType  TreeNode::* data  = &TreeNode::data,
+                     TreeNode* TreeNode::* left  = &TreeNode::left,
+                     TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_new_node(heap, value, data, left, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Destroys a node of a binary tree created with a given allocator.
+///
+/// @param[in]  alloc  node allocator the node was created with
+/// @param[in]  node   node to be destroyed
+/// @param[in]  date   [opt] pointers to data,left,right members
+/// @return            void
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type>
+void
+binary_tree_destroy_node(Allocator &alloc, TreeNode* node,
+                         DataType  TreeNode::* data  = &TreeNode::data)
+{
+    TDEBUG(("- destroy: %s\n") % node->*data);
+    alloc.deallocate(node);
+}
+
 /// ----------------------------------------------------------------------------
 /// @brief Destroys a node of a binary tree.
 ///
@@ -67,21 +355,24 @@ void
 binary_tree_destroy_node(TreeNode* node,
                          DataType  TreeNode::* data  = &TreeNode::data)
 {
-    TDEBUG(("- destroy: %s\n") % node->*data);
-    node->left = nullptr;
-    node->right = nullptr;
-    delete node;
+    binary_tree_heap_allocator<TreeNode> heap;
+    binary_tree_destroy_node(heap, node, data);
 }
 
 /// ----------------------------------------------------------------------------
-/// @brief Destroyes a binary tree. Extra memory O(n).
+/// @brief Destroyes a binary tree created with a given allocator node by node.
+///        Extra memory O(n). (To drop all the nodes of a node pool at once,
+///        use binary_tree_node_pool::release() instead.)
 ///
+/// @param[in]  alloc            node allocator the tree was created with
 /// @param[in]  root             root of the binary tree
 /// @param[in]  data,left,right  [opt] pointers to data,left,right members
 /// @return                      void
-template <typename TreeNode, typename DataType = typename TreeNode::data_type>
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type>
 void
-binary_tree_destroy_tree(TreeNode* root,
+binary_tree_destroy_tree(Allocator &alloc, TreeNode* root,
                          DataType TreeNode::*data = &TreeNode::data,
                          TreeNode* TreeNode::*left = &TreeNode::left,
                          TreeNode* TreeNode::*right = &TreeNode::right)
@@ -89,23 +380,44 @@ binary_tree_destroy_tree(TreeNode* root,
     // run inorder traversal and destroy the nodes
     // as we visit them
     binary_tree_traverse_inorder(root,
-                                 [ &data ] (TreeNode *node) {
-                                     binary_tree_destroy_node(node, data);
+                                 [ &alloc, &data ] (TreeNode *node) {
+                                     binary_tree_destroy_node(alloc, node,
+                                                              data);
                                  },
                                  left, right);
 }
 
 /// ----------------------------------------------------------------------------
-/// @brief Inserts a node into a binary tree at a random position
+/// @brief Destroyes a binary tree. Extra memory O(n).
 ///
+/// @param[in]  root             root of the binary tree
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      void
+template <typename TreeNode, typename DataType = typename TreeNode::data_type>
+void
+binary_tree_destroy_tree(TreeNode* root,
+                         DataType TreeNode::*data = &TreeNode::data,
+                         TreeNode* TreeNode::*left = &TreeNode::left,
+                         TreeNode* TreeNode::*right = &TreeNode::right)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    binary_tree_destroy_tree(heap, root, data, left, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node created with a given allocator into a binary tree
+///        at a random position
+///
+/// @param[in]  alloc       node allocator
 /// @param[in]  root        root of the binary tree
 /// @param[in]  value       a value to be inserted
 /// @param[in]  left,right  [opt] pointers to left,right members
 /// @return                 a new node with a given value
-template <typename TreeNode,
+template <typename Allocator,
+          typename TreeNode,
           typename DataType = typename TreeNode::data_type>
 TreeNode*
-binary_tree_insert_randomly(TreeNode* root, DataType value,
+binary_tree_insert_randomly(Allocator &alloc, TreeNode* root, DataType value,
                             TreeNode* TreeNode::* left  = &TreeNode::left,
                             TreeNode* TreeNode::* right = &TreeNode::right)
 {
@@ -122,11 +434,29 @@ binary_tree_insert_randomly(TreeNode* root, DataType value,
         node = node->*child;
     }
 
-    prev->*child =
-        binary_tree_new_node<TreeNode, DataType>(value);
+    prev->*child = binary_tree_new_node(alloc, value, &TreeNode::data,
+                                        left, right);
     return prev->*child;
 }
 
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node into a binary tree at a random position
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  value       a value to be inserted
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 a new node with a given value
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type>
+TreeNode*
+binary_tree_insert_randomly(TreeNode* root, DataType value,
+                            TreeNode* TreeNode::* left  = &TreeNode::left,
+                            TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_insert_randomly(heap, root, value, left, right);
+}
+
 /// ----------------------------------------------------------------------------
 /// @brief Functor that compares values of two binary tree nodes
 ///
@@ -146,18 +476,21 @@ struct binary_tree_node_comparator
 */
 
 /// ----------------------------------------------------------------------------
-/// @brief Inserts a node into a binary search tree
+/// @brief Inserts a node created with a given allocator into a binary search
+///        tree
 ///
+/// @param[in]  alloc            node allocator
 /// @param[in]  root             root of the binary tree
 /// @param[in]  value            a new value to be inserted
 /// @param[in]  comp             [opt] comparator used to compare two nodes
 /// @param[in]  data,left,right  [opt] pointers to data,left,right members
 /// @return                      a node with a given value
-template <typename TreeNode,
+template <typename Allocator,
+          typename TreeNode,
           typename DataType = typename TreeNode::data_type,
           typename Comparator = std::less<DataType> >
 TreeNode*
-binary_tree_insert_bst(TreeNode* node, DataType value,
+binary_tree_insert_bst(Allocator &alloc, TreeNode* node, DataType value,
                        Comparator comp = Comparator(),
                        DataType  TreeNode::* data  = &TreeNode::data,
                        TreeNode* TreeNode::* left  = &TreeNode::left,
@@ -180,8 +513,7 @@ binary_tree_insert_bst(TreeNode* node, DataType value,
     }
 
     if (!node) {
-        prev->*child =
-            binary_tree_new_node<TreeNode, DataType>(value, data, left, right);
+        prev->*child = binary_tree_new_node(alloc, value, data, left, right);
         node = prev->*child;
     } else {
         TDEBUG(("node already exists: %-03s (%p)\n") % value % node);
@@ -190,6 +522,28 @@ binary_tree_insert_bst(TreeNode* node, DataType value,
     return node;
 }
 
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node into a binary search tree
+///
+/// @param[in]  root             root of the binary tree
+/// @param[in]  value            a new value to be inserted
+/// @param[in]  comp             [opt] comparator used to compare two nodes
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      a node with a given value
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_insert_bst(TreeNode* node, DataType value,
+                       Comparator comp = Comparator(),
+                       DataType  TreeNode::* data  = &TreeNode::data,
+                       TreeNode* TreeNode::* left  = &TreeNode::left,
+                       TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_insert_bst(heap, node, value, comp, data, left, right);
+}
+
 /// ----------------------------------------------------------------------------
 /// @brief Searches a given value in BST
 ///
@@ -219,7 +573,837 @@ binary_tree_search_bst(TreeNode* node, DataType value,
 }
 
 /// ----------------------------------------------------------------------------
-/// @brief Checks if a given BT is a BST
+/// @brief Pointer to the height member of a node (binary_tree_avl_node,
+///        binary_tree_os_node), null if the node has none
+///
+/// @return  &TreeNode::height or null
+template <typename TreeNode>
+auto
+binary_tree_height_member(int) -> decltype(&TreeNode::height)
+{
+    return &TreeNode::height;
+}
+
+template <typename TreeNode>
+int TreeNode::*
+binary_tree_height_member(long)
+{
+    return nullptr;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Pointer to the subtree size member of a node (binary_tree_os_node),
+///        null if the node has none
+///
+/// @return  &TreeNode::size or null
+template <typename TreeNode>
+auto
+binary_tree_size_member(int) -> decltype(&TreeNode::size)
+{
+    return &TreeNode::size;
+}
+
+template <typename TreeNode>
+size_t TreeNode::*
+binary_tree_size_member(long)
+{
+    return nullptr;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Links n nodes given in order into a perfectly balanced BT: the
+///        middle one is the root, the halves are its subtrees. The nodes
+///        are requested in preorder, and their heights and subtree sizes,
+///        if any, are set bottom up (a perfectly balanced BST is an AVL tree).
+///
+/// @param[in]  lo,hi        range of the node indices
+/// @param[in]  node         TreeNode* node(size_t i): i-th node in order
+/// @param[in]  left,right   pointers to left,right members
+/// @param[in]  height,size  pointers to height,size members, or null
+/// @return                  root of the tree
+template <typename TreeNode, typename NodeAt>
+TreeNode*
+binary_tree_link_balanced(size_t lo, size_t hi, NodeAt& node,
+                          TreeNode* TreeNode::* left,
+                          TreeNode* TreeNode::* right,
+                          int       TreeNode::* height,
+                          size_t    TreeNode::* size)
+{
+    if (lo == hi)
+        return nullptr;
+
+    size_t mid = lo + (hi - lo) / 2;
+    TreeNode* root = node(mid);
+    root->*left  = binary_tree_link_balanced<TreeNode>(lo, mid, node,
+                                                       left, right,
+                                                       height, size);
+    root->*right = binary_tree_link_balanced<TreeNode>(mid + 1, hi, node,
+                                                       left, right,
+                                                       height, size);
+    if (height) {
+        int hl = root->*left  ? (root->*left)->*height  : 0;
+        int hr = root->*right ? (root->*right)->*height : 0;
+        root->*height = 1 + std::max(hl, hr);
+    }
+    if (size) {
+        root->*size = hi - lo;
+    }
+    return root;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Checks if a range is strictly increasing, and if not, copies it
+///        sorted and without duplicates
+///
+/// @param[in]  first,last  range of values
+/// @param[out] sorted      sorted unique values, if the range is not
+/// @param[in]  comp        comparator
+/// @return                 true if the range is strictly increasing
+template <typename Iterator, typename DataType, typename Comparator>
+bool
+binary_tree_sort_unique(Iterator first, Iterator last,
+                        std::vector<DataType>& sorted, Comparator comp)
+{
+    auto not_less = [ & ] (const DataType& a, const DataType& b) {
+        return !comp(a, b);
+    };
+    if (std::adjacent_find(first, last, not_less) == last)
+        return true;
+
+    sorted.assign(first, last);
+    std::sort(sorted.begin(), sorted.end(), comp);
+    sorted.erase(std::unique(sorted.begin(), sorted.end(), not_less),
+                 sorted.end());
+    return false;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Builds a perfectly balanced BST of given values in O(n), instead
+///        of n calls to binary_tree_insert_bst, O(n logn) at best.
+///
+/// The nodes are allocated one after another in preorder, so with
+/// binary_tree_node_pool they take one contiguous block (see reserve()),
+/// and a node is followed in memory by its left child. If the values are
+/// not sorted, a sorted copy of them is made first, O(n logn). Duplicates
+/// are dropped, as binary_tree_insert_bst does. The heights of AVL nodes and
+/// the subtree sizes of order statistic nodes are set, so the tree can be
+/// used with binary_tree_insert_avl, binary_tree_insert_os etc.
+///
+/// @param[in]  alloc            node allocator
+/// @param[in]  first,last       random access range of values
+/// @param[in]  comp             [opt] comparator used to compare two nodes
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @param[in]  height,size      [opt] pointers to height,size members, null
+///                              by default for nodes without them
+/// @return                      root of the tree, null for an empty range
+template <typename Allocator,
+          typename Iterator,
+          typename TreeNode = typename Allocator::node_type,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_build_bst(Allocator &alloc, Iterator first, Iterator last,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data  = &TreeNode::data,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right,
+                      int       TreeNode::* height =
+                          binary_tree_height_member<TreeNode>(0),
+                      size_t    TreeNode::* size =
+                          binary_tree_size_member<TreeNode>(0))
+{
+    std::vector<DataType> sorted;
+    if (!binary_tree_sort_unique(first, last, sorted, comp)) {
+        return binary_tree_build_bst(alloc, sorted.begin(), sorted.end(),
+                                     comp, data, left, right, height, size);
+    }
+
+    size_t n = last - first;
+    alloc.reserve(n);
+    auto node = [ & ] (size_t i) {
+        return binary_tree_new_node(alloc, DataType(first[i]),
+                                    data, left, right);
+    };
+    return binary_tree_link_balanced<TreeNode>(0, n, node, left, right,
+                                               height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Builds a perfectly balanced BST of given values in O(n)
+///
+/// @param[in]  first,last       random access range of values
+/// @param[in]  comp             [opt] comparator used to compare two nodes
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @param[in]  height,size      [opt] pointers to height,size members
+/// @return                      root of the tree, null for an empty range
+template <typename TreeNode,
+          typename Iterator,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_build_bst(Iterator first, Iterator last,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data  = &TreeNode::data,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right,
+                      int       TreeNode::* height =
+                          binary_tree_height_member<TreeNode>(0),
+                      size_t    TreeNode::* size =
+                          binary_tree_size_member<TreeNode>(0))
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_build_bst(heap, first, last, comp, data, left, right,
+                                 height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Merges a batch of values into a BST in O(n + m): the nodes of the
+///        tree are merged in order with new nodes of the values missing in
+///        it, and relinked into a perfectly balanced BST.
+///
+/// The existing nodes are kept (pointers to them stay valid), only their
+/// links change, and the heights of AVL nodes and the subtree sizes of order
+/// statistic nodes are recalculated. For a batch much smaller than the tree,
+/// m calls to binary_tree_insert_bst or binary_tree_insert_avl, O(m logn),
+/// are cheaper.
+///
+/// @param[in]     alloc            node allocator
+/// @param[in,out] root             root of the BST (may be null)
+/// @param[in]     first,last       random access range of values
+/// @param[in]     comp             [opt] comparator used to compare two nodes
+/// @param[in]     data,left,right  [opt] pointers to data,left,right members
+/// @param[in]     height,size      [opt] pointers to height,size members,
+///                                 null by default for nodes without them
+/// @return                         number of the values inserted
+template <typename Allocator,
+          typename TreeNode,
+          typename Iterator,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+size_t
+binary_tree_merge_bst(Allocator &alloc, TreeNode*& root,
+                      Iterator first, Iterator last,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data  = &TreeNode::data,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right,
+                      int       TreeNode::* height =
+                          binary_tree_height_member<TreeNode>(0),
+                      size_t    TreeNode::* size =
+                          binary_tree_size_member<TreeNode>(0))
+{
+    std::vector<DataType> sorted;
+    if (!binary_tree_sort_unique(first, last, sorted, comp)) {
+        return binary_tree_merge_bst(alloc, root, sorted.begin(), sorted.end(),
+                                     comp, data, left, right, height, size);
+    }
+
+    std::vector<TreeNode*> nodes;
+    binary_tree_traverse_inorder(root, [ & ] (TreeNode* node) {
+            nodes.push_back(node);
+        }, left, right);
+
+    std::vector<TreeNode*> merged;
+    merged.reserve(nodes.size() + (last - first));
+    alloc.reserve(last - first);
+
+    auto it = nodes.begin();
+    for (; first != last; ++first) {
+        while (it != nodes.end() && comp((*it)->*data, *first)) {
+            merged.push_back(*it++);
+        }
+        if (it == nodes.end() || comp(*first, (*it)->*data)) {
+            merged.push_back(binary_tree_new_node(alloc, DataType(*first),
+                                                  data, left, right));
+        }
+    }
+    merged.insert(merged.end(), it, nodes.end());
+
+    auto node = [ & ] (size_t i) { return merged[i]; };
+    root = binary_tree_link_balanced<TreeNode>(0, merged.size(), node,
+                                               left, right, height, size);
+    return merged.size() - nodes.size();
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Merges a batch of values into a BST in O(n + m)
+///
+/// @param[in,out] root             root of the BST (may be null)
+/// @param[in]     first,last       random access range of values
+/// @param[in]     comp             [opt] comparator used to compare two nodes
+/// @param[in]     data,left,right  [opt] pointers to data,left,right members
+/// @param[in]     height,size      [opt] pointers to height,size members
+/// @return                         number of the values inserted
+template <typename TreeNode,
+          typename Iterator,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+size_t
+binary_tree_merge_bst(TreeNode*& root, Iterator first, Iterator last,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data  = &TreeNode::data,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right,
+                      int       TreeNode::* height =
+                          binary_tree_height_member<TreeNode>(0),
+                      size_t    TreeNode::* size =
+                          binary_tree_size_member<TreeNode>(0))
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_merge_bst(heap, root, first, last,
+                                 comp, data, left, right, height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Height of an AVL subtree
+///
+/// @param[in]  node    root of the subtree (may be null)
+/// @param[in]  height  [opt] pointer to the height member
+/// @return             height of the subtree, 0 for an empty one
+template <typename TreeNode>
+int
+binary_tree_avl_height(TreeNode* node,
+                       int TreeNode::* height = &TreeNode::height)
+{
+    return node ? node->*height : 0;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Number of nodes of a subtree with subtree sizes in the nodes
+///
+/// @param[in]  node  root of the subtree (may be null)
+/// @param[in]  size  [opt] pointer to the size member
+/// @return           number of nodes, 0 for an empty subtree
+template <typename TreeNode>
+size_t
+binary_tree_os_size(TreeNode* node,
+                    size_t TreeNode::* size = &TreeNode::size)
+{
+    return node ? node->*size : 0;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Recalculates the height (and the subtree size) of an AVL node from
+///        its children
+///
+/// @param[in]  node               a node of the AVL tree
+/// @param[in]  left,right,height  [opt] pointers to left,right,height members
+/// @param[in]  size               [opt] pointer to the size member, if any
+/// @return                        void
+template <typename TreeNode>
+void
+binary_tree_avl_update(TreeNode* node,
+                       TreeNode* TreeNode::* left   = &TreeNode::left,
+                       TreeNode* TreeNode::* right  = &TreeNode::right,
+                       int       TreeNode::* height = &TreeNode::height,
+                       size_t    TreeNode::* size   = nullptr)
+{
+    node->*height = 1 + std::max(binary_tree_avl_height(node->*left, height),
+                                 binary_tree_avl_height(node->*right, height));
+    if (size) {
+        node->*size = 1 + binary_tree_os_size(node->*left, size) +
+                          binary_tree_os_size(node->*right, size);
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Rotates an AVL subtree to the right: the left child becomes the
+///        root of the subtree
+///
+/// @param[in]  link               reference to the pointer to the subtree root
+/// @param[in]  left,right,height  [opt] pointers to left,right,height members
+/// @param[in]  size               [opt] pointer to the size member, if any
+/// @return                        void
+template <typename TreeNode>
+void
+binary_tree_avl_rotate_right(TreeNode*& link,
+                             TreeNode* TreeNode::* left   = &TreeNode::left,
+                             TreeNode* TreeNode::* right  = &TreeNode::right,
+                             int       TreeNode::* height = &TreeNode::height,
+                             size_t    TreeNode::* size   = nullptr)
+{
+    TreeNode* node = link;
+    TreeNode* child = node->*left;
+    node->*left = child->*right;
+    child->*right = node;
+    binary_tree_avl_update(node, left, right, height, size);
+    binary_tree_avl_update(child, left, right, height, size);
+    link = child;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Restores the AVL property of a subtree whose children are AVL trees
+///        with heights differing by at most 2, and updates its height
+///
+/// @param[in]  link               reference to the pointer to the subtree root
+/// @param[in]  left,right,height  [opt] pointers to left,right,height members
+/// @param[in]  size               [opt] pointer to the size member, if any
+/// @return                        void
+template <typename TreeNode>
+void
+binary_tree_avl_rebalance(TreeNode*& link,
+                          TreeNode* TreeNode::* left   = &TreeNode::left,
+                          TreeNode* TreeNode::* right  = &TreeNode::right,
+                          int       TreeNode::* height = &TreeNode::height,
+                          size_t    TreeNode::* size   = nullptr)
+{
+    TreeNode* node = link;
+    int balance = binary_tree_avl_height(node->*left, height) -
+                  binary_tree_avl_height(node->*right, height);
+
+    if (balance > 1) {
+        // left-right case => left-left case
+        TreeNode* child = node->*left;
+        if (binary_tree_avl_height(child->*left, height) <
+            binary_tree_avl_height(child->*right, height)) {
+            binary_tree_avl_rotate_right(node->*left, right, left, height,
+                                         size);
+        }
+        binary_tree_avl_rotate_right(link, left, right, height, size);
+    } else if (balance < -1) {
+        // mirrored: a left rotation is the right one with swapped children
+        TreeNode* child = node->*right;
+        if (binary_tree_avl_height(child->*right, height) <
+            binary_tree_avl_height(child->*left, height)) {
+            binary_tree_avl_rotate_right(node->*right, left, right, height,
+                                         size);
+        }
+        binary_tree_avl_rotate_right(link, right, left, height, size);
+    } else {
+        binary_tree_avl_update(node, left, right, height, size);
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Rebalances an AVL tree bottom up along a path of links from the
+///        root, stopping as soon as the height of a subtree doesn't change.
+///        The subtree sizes, if any, are updated all the way up.
+///
+/// @param[in]  path               links from the root down to the changed node
+/// @param[in]  depth              number of links in the path
+/// @param[in]  left,right,height  pointers to left,right,height members
+/// @param[in]  size               pointer to the size member, or null
+/// @return                        void
+template <typename TreeNode>
+void
+binary_tree_avl_fixup(TreeNode** path[], int depth,
+                      TreeNode* TreeNode::* left,
+                      TreeNode* TreeNode::* right,
+                      int       TreeNode::* height,
+                      size_t    TreeNode::* size)
+{
+    while (depth-- > 0) {
+        TreeNode*& link = *path[depth];
+        int h = link->*height;
+        binary_tree_avl_rebalance(link, left, right, height, size);
+        if (link->*height == h) {
+            break;
+        }
+    }
+    if (size) {
+        while (depth-- > 0) {
+            TreeNode* node = *path[depth];
+            node->*size = 1 + binary_tree_os_size(node->*left, size) +
+                              binary_tree_os_size(node->*right, size);
+        }
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node created with a given allocator into an AVL tree
+///        (self-balancing BST). O(logN) in the worst case, whatever the order
+///        of insertions is.
+///
+/// @param[in]     alloc                   node allocator
+/// @param[in,out] root                    root of the AVL tree (may change)
+/// @param[in]     value                   a new value to be inserted
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member,
+///                                        if any (see binary_tree_os_node)
+/// @return                                a node with a given value
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_insert_avl(Allocator &alloc, TreeNode*& root, DataType value,
+                       Comparator comp = Comparator(),
+                       DataType  TreeNode::* data   = &TreeNode::data,
+                       TreeNode* TreeNode::* left   = &TreeNode::left,
+                       TreeNode* TreeNode::* right  = &TreeNode::right,
+                       int       TreeNode::* height = &TreeNode::height,
+                       size_t    TreeNode::* size   = nullptr)
+{
+    TreeNode** path[binary_tree_avl_max_height];
+    int depth = 0;
+
+    TreeNode** link = &root;
+    while (*link && ((*link)->*data != value)) {
+        path[depth++] = link;
+        if (comp(value, (*link)->*data)) {
+            link = &((*link)->*left);
+        } else {
+            link = &((*link)->*right);
+        }
+    }
+
+    if (*link) {
+        TDEBUG(("node already exists: %-03s (%p)\n") % value % *link);
+        return *link;
+    }
+
+    TreeNode* node = binary_tree_new_node(alloc, value, data, left, right);
+    node->*height = 1;
+    if (size) {
+        node->*size = 1;
+    }
+    *link = node;
+
+    binary_tree_avl_fixup(path, depth, left, right, height, size);
+    return node;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node into an AVL tree (self-balancing BST)
+///
+/// @param[in,out] root                    root of the AVL tree (may change)
+/// @param[in]     value                   a new value to be inserted
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member,
+///                                        if any (see binary_tree_os_node)
+/// @return                                a node with a given value
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_insert_avl(TreeNode*& root, DataType value,
+                       Comparator comp = Comparator(),
+                       DataType  TreeNode::* data   = &TreeNode::data,
+                       TreeNode* TreeNode::* left   = &TreeNode::left,
+                       TreeNode* TreeNode::* right  = &TreeNode::right,
+                       int       TreeNode::* height = &TreeNode::height,
+                       size_t    TreeNode::* size   = nullptr)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_insert_avl(heap, root, value, comp, data, left, right,
+                                  height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Erases a value from an AVL tree created with a given allocator.
+///        O(logN). A node with two children is replaced by its inorder
+///        successor node (relinked, the data is not copied), so pointers
+///        to the other nodes stay valid.
+///
+/// @param[in]     alloc                   node allocator
+/// @param[in,out] root                    root of the AVL tree (may change)
+/// @param[in]     value                   a value to be erased
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member,
+///                                        if any (see binary_tree_os_node)
+/// @return                                true if erased, false if not found
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_erase_avl(Allocator &alloc, TreeNode*& root, DataType value,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data   = &TreeNode::data,
+                      TreeNode* TreeNode::* left   = &TreeNode::left,
+                      TreeNode* TreeNode::* right  = &TreeNode::right,
+                      int       TreeNode::* height = &TreeNode::height,
+                      size_t    TreeNode::* size   = nullptr)
+{
+    TreeNode** path[binary_tree_avl_max_height];
+    int depth = 0;
+
+    TreeNode** link = &root;
+    while (*link && ((*link)->*data != value)) {
+        path[depth++] = link;
+        if (comp(value, (*link)->*data)) {
+            link = &((*link)->*left);
+        } else {
+            link = &((*link)->*right);
+        }
+    }
+
+    TreeNode* node = *link;
+    if (!node) {
+        return false;
+    }
+
+    if (!(node->*left)) {
+        *link = node->*right;
+    } else if (!(node->*right)) {
+        *link = node->*left;
+    } else {
+        // unlink the successor (the leftmost node of the right subtree)
+        // and put it in the place of the node
+        int top = depth;
+        path[depth++] = link;
+        TreeNode** slink = &(node->*right);
+        while ((*slink)->*left) {
+            path[depth++] = slink;
+            slink = &((*slink)->*left);
+        }
+        TreeNode* succ = *slink;
+        *slink = succ->*right;
+
+        succ->*left   = node->*left;
+        succ->*right  = node->*right;
+        succ->*height = node->*height;
+        *link = succ;
+        if (top + 1 < depth) {
+            path[top + 1] = &(succ->*right);
+        }
+    }
+
+    binary_tree_destroy_node(alloc, node, data);
+    binary_tree_avl_fixup(path, depth, left, right, height, size);
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Erases a value from an AVL tree
+///
+/// @param[in,out] root                    root of the AVL tree (may change)
+/// @param[in]     value                   a value to be erased
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member,
+///                                        if any (see binary_tree_os_node)
+/// @return                                true if erased, false if not found
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_erase_avl(TreeNode*& root, DataType value,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data   = &TreeNode::data,
+                      TreeNode* TreeNode::* left   = &TreeNode::left,
+                      TreeNode* TreeNode::* right  = &TreeNode::right,
+                      int       TreeNode::* height = &TreeNode::height,
+                      size_t    TreeNode::* size   = nullptr)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_erase_avl(heap, root, value, comp, data, left, right,
+                                 height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node created with a given allocator into an order
+///        statistic tree: an AVL tree with the subtree sizes in the nodes
+///        (see binary_tree_os_node). O(logN).
+///
+/// @param[in]     alloc                   node allocator
+/// @param[in,out] root                    root of the tree (may change)
+/// @param[in]     value                   a new value to be inserted
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member
+/// @return                                a node with a given value
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_insert_os(Allocator &alloc, TreeNode*& root, DataType value,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data   = &TreeNode::data,
+                      TreeNode* TreeNode::* left   = &TreeNode::left,
+                      TreeNode* TreeNode::* right  = &TreeNode::right,
+                      int       TreeNode::* height = &TreeNode::height,
+                      size_t    TreeNode::* size   = &TreeNode::size)
+{
+    return binary_tree_insert_avl(alloc, root, value, comp, data, left, right,
+                                  height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inserts a node into an order statistic tree. O(logN).
+///
+/// @param[in,out] root                    root of the tree (may change)
+/// @param[in]     value                   a new value to be inserted
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member
+/// @return                                a node with a given value
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+TreeNode*
+binary_tree_insert_os(TreeNode*& root, DataType value,
+                      Comparator comp = Comparator(),
+                      DataType  TreeNode::* data   = &TreeNode::data,
+                      TreeNode* TreeNode::* left   = &TreeNode::left,
+                      TreeNode* TreeNode::* right  = &TreeNode::right,
+                      int       TreeNode::* height = &TreeNode::height,
+                      size_t    TreeNode::* size   = &TreeNode::size)
+{
+    return binary_tree_insert_avl(root, value, comp, data, left, right,
+                                  height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Erases a value from an order statistic tree created with a given
+///        allocator. O(logN).
+///
+/// @param[in]     alloc                   node allocator
+/// @param[in,out] root                    root of the tree (may change)
+/// @param[in]     value                   a value to be erased
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member
+/// @return                                true if erased, false if not found
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_erase_os(Allocator &alloc, TreeNode*& root, DataType value,
+                     Comparator comp = Comparator(),
+                     DataType  TreeNode::* data   = &TreeNode::data,
+                     TreeNode* TreeNode::* left   = &TreeNode::left,
+                     TreeNode* TreeNode::* right  = &TreeNode::right,
+                     int       TreeNode::* height = &TreeNode::height,
+                     size_t    TreeNode::* size   = &TreeNode::size)
+{
+    return binary_tree_erase_avl(alloc, root, value, comp, data, left, right,
+                                 height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Erases a value from an order statistic tree. O(logN).
+///
+/// @param[in,out] root                    root of the tree (may change)
+/// @param[in]     value                   a value to be erased
+/// @param[in]     comp                    [opt] comparator
+/// @param[in]     data,left,right,height  [opt] pointers to the members
+/// @param[in]     size                    [opt] pointer to the size member
+/// @return                                true if erased, false if not found
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_erase_os(TreeNode*& root, DataType value,
+                     Comparator comp = Comparator(),
+                     DataType  TreeNode::* data   = &TreeNode::data,
+                     TreeNode* TreeNode::* left   = &TreeNode::left,
+                     TreeNode* TreeNode::* right  = &TreeNode::right,
+                     int       TreeNode::* height = &TreeNode::height,
+                     size_t    TreeNode::* size   = &TreeNode::size)
+{
+    return binary_tree_erase_avl(root, value, comp, data, left, right,
+                                 height, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Finds the k-th smallest node of a BST with subtree sizes in the
+///        nodes. O(height).
+///
+/// @param[in]  root             root of the tree
+/// @param[in]  k                0-based index of the node in order
+/// @param[in]  left,right,size  [opt] pointers to left,right,size members
+/// @return                      the k-th node, null if k >= size of the tree
+template <typename TreeNode>
+TreeNode*
+binary_tree_select(TreeNode* root, size_t k,
+                   TreeNode* TreeNode::* left  = &TreeNode::left,
+                   TreeNode* TreeNode::* right = &TreeNode::right,
+                   size_t    TreeNode::* size  = &TreeNode::size)
+{
+    TreeNode* node = root;
+    while (node) {
+        size_t l = binary_tree_os_size(node->*left, size);
+        if (k < l) {
+            node = node->*left;
+        } else if (k == l) {
+            return node;
+        } else {
+            k -= l + 1;
+            node = node->*right;
+        }
+    }
+    return nullptr;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Rank of a value in a BST with subtree sizes in the nodes: the
+///        number of values less than it (its index, if it is in the tree).
+///        O(height).
+///
+/// @param[in]  root                  root of the tree
+/// @param[in]  value                 value to rank
+/// @param[in]  comp                  [opt] comparator
+/// @param[in]  data,left,right,size  [opt] pointers to the members
+/// @return                           number of values less than the value
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+size_t
+binary_tree_rank(TreeNode* root, DataType value,
+                 Comparator comp = Comparator(),
+                 DataType  TreeNode::* data  = &TreeNode::data,
+                 TreeNode* TreeNode::* left  = &TreeNode::left,
+                 TreeNode* TreeNode::* right = &TreeNode::right,
+                 size_t    TreeNode::* size  = &TreeNode::size)
+{
+    size_t rank = 0;
+    TreeNode* node = root;
+    while (node) {
+        if (comp(node->*data, value)) {
+            rank += binary_tree_os_size(node->*left, size) + 1;
+            node = node->*right;
+        } else {
+            node = node->*left;
+        }
+    }
+    return rank;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Counts the values in [lo, hi] in a BST with subtree sizes in the
+///        nodes, without visiting them. O(height).
+///
+/// @param[in]  root                  root of the tree
+/// @param[in]  lo,hi                 range of values, both included
+/// @param[in]  comp                  [opt] comparator
+/// @param[in]  data,left,right,size  [opt] pointers to the members
+/// @return                           number of values in the range
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+size_t
+binary_tree_count_range(TreeNode* root, DataType lo, DataType hi,
+                        Comparator comp = Comparator(),
+                        DataType  TreeNode::* data  = &TreeNode::data,
+                        TreeNode* TreeNode::* left  = &TreeNode::left,
+                        TreeNode* TreeNode::* right = &TreeNode::right,
+                        size_t    TreeNode::* size  = &TreeNode::size)
+{
+    if (comp(hi, lo))
+        return 0;
+
+    // the values not greater than hi, minus the ones less than lo
+    size_t count = 0;
+    TreeNode* node = root;
+    while (node) {
+        if (comp(hi, node->*data)) {
+            node = node->*left;
+        } else {
+            count += binary_tree_os_size(node->*left, size) + 1;
+            node = node->*right;
+        }
+    }
+    return count - binary_tree_rank(root, lo, comp, data, left, right, size);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Checks if a given BT is a BST. Stops at the first violation.
 ///
 /// @param[in]  root             root of the binary tree
 /// @param[in]  comp             [opt] comparator used to compare two nodes
@@ -239,68 +1423,103 @@ binary_tree_is_bst(TreeNode* root,
     bool is_bst = true;
     TreeNode *prev = nullptr;
 
+    // stop at the first pair of nodes out of order
     auto is_bst_cb = [ & ] (TreeNode* node) {
-        if (prev && is_bst) {
+        if (prev) {
             is_bst = comp(prev->*data, node->*data);
         }
         prev = node;
+        return is_bst;
     };
 
-    binary_tree_traverse_inorder(root, is_bst_cb);
+    binary_tree_traverse_inorder(root, is_bst_cb, left, right);
 
     return is_bst;
 }
 
 /// ----------------------------------------------------------------------------
-/// @brief Checks if a given BT is a balanced BT
+/// @brief Height of a binary tree if it is balanced (the heights of the two
+///        subtrees of every node differ by at most 1). Iterative postorder
+///        with the height of the left subtree carried on the stack, extra
+///        memory O(h). Stops at the first unbalanced node.
 ///
-/// @param[in]  root             root of the binary tree
-/// @param[in]  comp             [opt] comparator used to compare two nodes
-/// @param[in]  data,left,right  [opt] pointers to data,left,right members
-/// @return                      true if BT is balanced, false otherwise
-template <typename TreeNode,
-          typename DataType = typename TreeNode::data_type,
-          typename Comparator = std::less<DataType> >
-bool
-binary_tree_is_balanced(TreeNode* root,
-                        Comparator comp = Comparator(),
-                        DataType  TreeNode::* data  = &TreeNode::data,
-                        TreeNode* TreeNode::* left  = &TreeNode::left,
-                        TreeNode* TreeNode::* right = &TreeNode::right)
+/// @param[in]  root        root of the binary tree
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 height (0 for an empty tree, 1 for a leaf),
+///                         or -1 if the tree is not balanced
+template <typename TreeNode>
+int
+binary_tree_balanced_height(TreeNode* root,
+                            TreeNode* TreeNode::* left  = &TreeNode::left,
+                            TreeNode* TreeNode::* right = &TreeNode::right)
 {
+    struct frame {
+        TreeNode* node;
+        int h_left;   // height of the left subtree, once it is done
+        bool right;   // true when going down to the right
+    };
 
-    std::map<TreeNode*, int> n2h;
-
-    auto balanced_cb = [ & ] (TreeNode* node) {
+    binary_tree_stack<frame> stack;
+    int h = 0;  // height of the last finished subtree
 
-        int h_left = 0, h_right = 0;
-        if (node->*left) {
-            h_left = n2h[node->*left];
+    if (root) {
+        stack.push({ root, 0, false });
+    }
+    while (!stack.empty()) {
+        frame& f = stack.top();
+        if (!f.right) {
+            // go down to the left first (h = 0 if there is no left child)
+            f.right = true;
+            TreeNode* child = f.node->*left;
+            if (child) {
+                stack.push({ child, 0, false });
+            } else {
+                h = 0;
+            }
+            continue;
         }
-        if (node->*right) {
-            h_right = n2h[node->*right];
+        if (f.node && h >= 0) {
+            // back from the left: save its height, go down to the right
+            f.h_left = h;
+            TreeNode* child = f.node->*right;
+            f.node = nullptr;  // both children visited next time
+            if (child) {
+                stack.push({ child, 0, false });
+            } else {
+                h = 0;
+            }
+            continue;
         }
-
-        if (h_left == -1 || h_right == -1 ||
-            std::abs(h_left - h_right) > 1) {
-            // left or right subtree is not balanced
-            // or balance is broken at this node
-            n2h[node] = -1;
-        } else if (node->*left || node->*right) {
-            // if any child exists, calculate height
-            n2h[node] = std::max(h_left, h_right) + 1;
-        } else {
-            // leaf
-            n2h[node] = 0;
+        // back from the right (or the left subtree is not balanced)
+        if (h < 0 || f.h_left < 0 || std::abs(f.h_left - h) > 1) {
+            return -1;
         }
+        h = std::max(f.h_left, h) + 1;
+        stack.pop();
+    }
+    return h;
+}
 
-        TDEBUG(("data = %2s, hl = %2s, hr = %2s, h = %2s\n")
-               % node->data % h_left % h_right % n2h[node]);
-    };
-
-    binary_tree_traverse_postorder(root, balanced_cb);
+/// ----------------------------------------------------------------------------
+/// @brief Checks if a given BT is a balanced BT. Extra memory O(h), stops at
+///        the first unbalanced node (see binary_tree_balanced_height).
+///
+/// @param[in]  root             root of the binary tree
+/// @param[in]  comp             [opt] comparator used to compare two nodes
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      true if BT is balanced, false otherwise
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_is_balanced(TreeNode* root,
+                        Comparator comp = Comparator(),
+                        DataType  TreeNode::* data  = &TreeNode::data,
+                        TreeNode* TreeNode::* left  = &TreeNode::left,
+                        TreeNode* TreeNode::* right = &TreeNode::right)
+{
 
-    return n2h[root] >= 0;
+    return binary_tree_balanced_height(root, left, right) >= 0;
 }
 
 /// ----------------------------------------------------------------------------
@@ -310,14 +1529,14 @@ binary_tree_is_balanced(TreeNode* root,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_inorder(TreeNode* node, Visitor visit,
                              TreeNode* TreeNode::* left  = &TreeNode::left,
                              TreeNode* TreeNode::* right = &TreeNode::right)
 {
-    std::stack<TreeNode*> stack;
+    binary_tree_stack<TreeNode*> stack;
     while (node || !stack.empty()) {
         if (node) {
             // *** go left as deep as possible
@@ -329,11 +1548,15 @@ binary_tree_traverse_inorder(TreeNode* node, Visitor visit,
             // 1. go to the right child next
             node = stack.top()->*right;      // It is important here
             // 2. visit the node             // NOT to access the node
-            visit(stack.top());              // that has been visited, since
-            // 3. pop from the stack         // the visitor might have
-            stack.pop();                     // destroyed the node already!
+            if (!binary_tree_visit(visit,    // that has been visited, since
+                                   stack.top())) {
+                return false;                // the visitor might have
+            }                                // destroyed the node already!
+            // 3. pop from the stack
+            stack.pop();
         }
     }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
@@ -343,19 +1566,20 @@ binary_tree_traverse_inorder(TreeNode* node, Visitor visit,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_preorder(TreeNode* node, Visitor visit,
                               TreeNode* TreeNode::* left  = &TreeNode::left,
                               TreeNode* TreeNode::* right = &TreeNode::right)
 {
-    std::stack<TreeNode*> stack;
+    binary_tree_stack<TreeNode*> stack;
     while (node || !stack.empty()) {
         if (node) {
             // *** go left as deep as possible
             // 1. visit the node
-            visit(node);
+            if (!binary_tree_visit(visit, node))
+                return false;
             // 2. if right child exists, push it to the stack
             if (node->*right)
                 stack.push(node->*right);
@@ -368,6 +1592,7 @@ binary_tree_traverse_preorder(TreeNode* node, Visitor visit,
             stack.pop();
         }
     }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
@@ -377,18 +1602,18 @@ binary_tree_traverse_preorder(TreeNode* node, Visitor visit,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_postorder(TreeNode* node, Visitor visit,
                                TreeNode* TreeNode::* left  = &TreeNode::left,
                                TreeNode* TreeNode::* right = &TreeNode::right)
 {
     if (!node) {
-        return;
+        return true;
     }
 
-    std::stack<TreeNode*> stack;
+    binary_tree_stack<TreeNode*> stack;
     stack.push(node);
     TreeNode* prev = nullptr;
 
@@ -416,11 +1641,13 @@ binary_tree_traverse_postorder(TreeNode* node, Visitor visit,
         }
         // (3) at the bottom or backtracking from the right
         else {
-            visit(node);                  // finally, visit the node
+            if (!binary_tree_visit(visit, node)) // finally, visit the node
+                return false;
             stack.pop();
         }
         prev = node;                      // update the prev position
     }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
@@ -430,14 +1657,14 @@ binary_tree_traverse_postorder(TreeNode* node, Visitor visit,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_postorder1(TreeNode* node, Visitor visit,
                                 TreeNode* TreeNode::* left  = &TreeNode::left,
                                 TreeNode* TreeNode::* right = &TreeNode::right)
 {
-    std::stack<TreeNode*> stack;
+    binary_tree_stack<TreeNode*> stack;
 
     while (node || !stack.empty()) {
 
@@ -461,11 +1688,13 @@ binary_tree_traverse_postorder1(TreeNode* node, Visitor visit,
                 // go to the right child next
                 node = node->*right;
             } else {
-                visit(node);
+                if (!binary_tree_visit(visit, node))
+                    return false;
                 node = NULL;
             }
         }
     }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
@@ -475,14 +1704,14 @@ binary_tree_traverse_postorder1(TreeNode* node, Visitor visit,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_postorder2(TreeNode* node, Visitor visit,
                                 TreeNode* TreeNode::* left  = &TreeNode::left,
                                 TreeNode* TreeNode::* right = &TreeNode::right)
 {
-    std::stack<TreeNode*> stack;
+    binary_tree_stack<TreeNode*> stack;
 
     // The 2 stacks solution for the iterative postorder traversal.
     //
@@ -503,30 +1732,273 @@ binary_tree_traverse_postorder2(TreeNode* node, Visitor visit,
                                   left); // instead of right! :)
 
     while (!stack.empty()) {
-        visit(stack.top());
+        if (!binary_tree_visit(visit, stack.top()))
+            return false;
         stack.pop();
     }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
-/// @brief Recursive inorder traversal of a binary tree. Extra memory O(n).
+/// @brief Removes the threads left in a binary tree by a Morris traversal
+///        stopped by its visitor. From where the traversal has stopped, right
+///        pointers lead up through all the threads left.
+///
+/// @param[in]  node        node to continue from
+/// @param[in]  threads     number of threads left
+/// @param[in]  left,right  pointers to left,right members
+/// @return                 void
+template <typename TreeNode>
+void
+binary_tree_morris_unthread(TreeNode* node, int threads,
+                            TreeNode* TreeNode::* left,
+                            TreeNode* TreeNode::* right)
+{
+    while (threads > 0) {
+        if (node->*left) {
+            TreeNode* pred = node->*left;
+            while (pred->*right && pred->*right != node) {
+                pred = pred->*right;
+            }
+            if (pred->*right == node) {
+                pred->*right = nullptr;
+                threads--;
+            }
+        }
+        node = node->*right;
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Morris inorder traversal of a binary tree. Extra memory O(1).
+///
+/// Instead of a stack, the way back up is a temporary thread: the right
+/// pointer of the inorder predecessor of a node (the rightmost node of its
+/// left subtree) is pointed to the node before going down to the left, and
+/// reset when the node is reached again through it. Every edge is walked at
+/// most 3 times. The tree is modified during the traversal, so the visitor
+/// must not change the structure of the tree (and the tree must not be
+/// shared with other threads). If the visitor stops the traversal, the
+/// threads left are removed before return.
 ///
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
+template <typename TreeNode, typename Visitor>
+bool
+binary_tree_traverse_inorder_morris(TreeNode* node, Visitor visit,
+                                    TreeNode* TreeNode::* left  = &TreeNode::left,
+                                    TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    int threads = 0;
+    while (node) {
+        if (!(node->*left)) {
+            if (!binary_tree_visit(visit, node)) {
+                binary_tree_morris_unthread(node->*right, threads, left, right);
+                return false;
+            }
+            node = node->*right;
+            continue;
+        }
+
+        TreeNode* pred = node->*left;
+        while (pred->*right && pred->*right != node) {
+            pred = pred->*right;
+        }
+
+        if (!(pred->*right)) {
+            // first time here: thread the way back, go to the left
+            pred->*right = node;
+            threads++;
+            node = node->*left;
+        } else {
+            // back from the left subtree: remove the thread
+            pred->*right = nullptr;
+            threads--;
+            if (!binary_tree_visit(visit, node)) {
+                binary_tree_morris_unthread(node->*right, threads, left, right);
+                return false;
+            }
+            node = node->*right;
+        }
+    }
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Morris preorder traversal of a binary tree. Extra memory O(1).
+///        (See binary_tree_traverse_inorder_morris.)
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  visit       visitor callback
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
+bool
+binary_tree_traverse_preorder_morris(TreeNode* node, Visitor visit,
+                                     TreeNode* TreeNode::* left  = &TreeNode::left,
+                                     TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    int threads = 0;
+    while (node) {
+        if (!(node->*left)) {
+            if (!binary_tree_visit(visit, node)) {
+                binary_tree_morris_unthread(node->*right, threads, left, right);
+                return false;
+            }
+            node = node->*right;
+            continue;
+        }
+
+        TreeNode* pred = node->*left;
+        while (pred->*right && pred->*right != node) {
+            pred = pred->*right;
+        }
+
+        if (!(pred->*right)) {
+            // the only difference from inorder: visit on the way down
+            if (!binary_tree_visit(visit, node)) {
+                binary_tree_morris_unthread(node->*right, threads, left, right);
+                return false;
+            }
+            pred->*right = node;
+            threads++;
+            node = node->*left;
+        } else {
+            pred->*right = nullptr;
+            threads--;
+            node = node->*right;
+        }
+    }
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Reverses the right pointers along a path of right children
+///
+/// @param[in]  from   first node of the path
+/// @param[in]  to     last node of the path
+/// @param[in]  right  pointer to the right member
+/// @return            void
+template <typename TreeNode>
 void
+binary_tree_reverse_right_path(TreeNode* from, TreeNode* to,
+                               TreeNode* TreeNode::* right)
+{
+    TreeNode* prev = nullptr;
+    TreeNode* node = from;
+    while (prev != to) {
+        TreeNode* next = node->*right;
+        node->*right = prev;
+        prev = node;
+        node = next;
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Visits a path of right children bottom up in O(1) extra memory:
+///        the path is reversed, walked, and reversed back
+///
+/// @param[in]  from   first (top) node of the path
+/// @param[in]  to     last (bottom) node of the path
+/// @param[in]  visit  visitor callback
+/// @param[in]  right  pointer to the right member
+/// @return            false if the visitor stopped (the path is restored)
+template <typename TreeNode, typename Visitor>
+bool
+binary_tree_visit_right_path_reversed(TreeNode* from, TreeNode* to,
+                                      Visitor& visit,
+                                      TreeNode* TreeNode::* right)
+{
+    TreeNode* end = to->*right;
+    bool go_on = true;
+    binary_tree_reverse_right_path(from, to, right);
+    for (TreeNode* node = to; node && go_on; node = node->*right) {
+        go_on = binary_tree_visit(visit, node);
+    }
+    binary_tree_reverse_right_path(to, from, right);
+    to->*right = end;
+    return go_on;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Morris postorder traversal of a binary tree. Extra memory O(1).
+///        (See binary_tree_traverse_inorder_morris.)
+///
+/// When a thread is removed, the right path from the left child down to the
+/// predecessor is finished, and it is visited bottom up; the right path from
+/// the root is the last one. The visitor is not allowed to change the tree.
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  visit       visitor callback
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 false if the visitor stopped the traversal
+template <typename TreeNode, typename Visitor>
+bool
+binary_tree_traverse_postorder_morris(TreeNode* root, Visitor visit,
+                                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                                      TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    if (!root) {
+        return true;
+    }
+
+    int threads = 0;
+    TreeNode* node = root;
+    while (node) {
+        if (!(node->*left)) {
+            node = node->*right;
+            continue;
+        }
+
+        TreeNode* pred = node->*left;
+        while (pred->*right && pred->*right != node) {
+            pred = pred->*right;
+        }
+
+        if (!(pred->*right)) {
+            pred->*right = node;
+            threads++;
+            node = node->*left;
+        } else {
+            pred->*right = nullptr;
+            threads--;
+            if (!binary_tree_visit_right_path_reversed(node->*left, pred,
+                                                       visit, right)) {
+                binary_tree_morris_unthread(node->*right, threads, left, right);
+                return false;
+            }
+            node = node->*right;
+        }
+    }
+
+    TreeNode* last = root;
+    while (last->*right) {
+        last = last->*right;
+    }
+    return binary_tree_visit_right_path_reversed(root, last, visit, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Recursive inorder traversal of a binary tree. Extra memory O(n).
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  visit       visitor callback
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 false if the visitor stopped the traversal
+template <typename TreeNode, typename Visitor>
+bool
 binary_tree_traverse_inorder_r(TreeNode* root, Visitor visit,
                                TreeNode* TreeNode::* left  = &TreeNode::left,
                                TreeNode* TreeNode::* right = &TreeNode::right)
 {
     if (!root) {
-        return;
+        return true;
     }
-    binary_tree_traverse_inorder_r(root->*left, visit);
-    visit(root);
-    binary_tree_traverse_inorder_r(root->*right, visit);
+    return binary_tree_traverse_inorder_r(root->*left, visit, left, right) &&
+           binary_tree_visit(visit, root) &&
+           binary_tree_traverse_inorder_r(root->*right, visit, left, right);
 }
 
 /// ----------------------------------------------------------------------------
@@ -535,19 +2007,19 @@ binary_tree_traverse_inorder_r(TreeNode* root, Visitor visit,
 /// @param[in]  root         root of the binary tree
 /// @param[in]  visit        visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                  void
+/// @return                  false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_preorder_r(TreeNode* root, Visitor visit,
                                 TreeNode* TreeNode::* left  = &TreeNode::left,
                                 TreeNode* TreeNode::* right = &TreeNode::right)
 {
     if (!root) {
-        return;
+        return true;
     }
-    visit(root);
-    binary_tree_traverse_preorder_r(root->*left, visit);
-    binary_tree_traverse_preorder_r(root->*right, visit);
+    return binary_tree_visit(visit, root) &&
+           binary_tree_traverse_preorder_r(root->*left, visit, left, right) &&
+           binary_tree_traverse_preorder_r(root->*right, visit, left, right);
 }
 
 /// ----------------------------------------------------------------------------
@@ -556,19 +2028,19 @@ binary_tree_traverse_preorder_r(TreeNode* root, Visitor visit,
 /// @param[in]  root         root of the binary tree
 /// @param[in]  visit        visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                  void
+/// @return                  false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_postorder_r(TreeNode* root, Visitor visit,
                                  TreeNode* TreeNode::* left  = &TreeNode::left,
                                  TreeNode* TreeNode::* right = &TreeNode::right)
 {
     if (!root) {
-        return;
+        return true;
     }
-    binary_tree_traverse_postorder_r(root->*left, visit);
-    binary_tree_traverse_postorder_r(root->*right, visit);
-    visit(root);
+    return binary_tree_traverse_postorder_r(root->*left, visit, left, right) &&
+           binary_tree_traverse_postorder_r(root->*right, visit, left, right) &&
+           binary_tree_visit(visit, root);
 }
 
 /// ----------------------------------------------------------------------------
@@ -577,9 +2049,9 @@ binary_tree_traverse_postorder_r(TreeNode* root, Visitor visit,
 /// @param[in]  root        root of the binary tree
 /// @param[in]  visit       visitor callback
 /// @param[in]  left,right  [opt] pointers to left,right members
-/// @return                 void
+/// @return                 false if the visitor stopped the traversal
 template <typename TreeNode, typename Visitor>
-void
+bool
 binary_tree_traverse_levels(TreeNode* root, Visitor visit,
                             TreeNode* TreeNode::* left  = &TreeNode::left,
                             TreeNode* TreeNode::* right = &TreeNode::right)
@@ -595,7 +2067,9 @@ binary_tree_traverse_levels(TreeNode* root, Visitor visit,
         queue.pop();
 
         // visit a node (node = nullptr means new level!)
-        visit(node);
+        if (!binary_tree_visit(visit, node)) {
+            return false;
+        }
 
         if (node) {
             // push any non-null children to the queue
@@ -610,6 +2084,279 @@ binary_tree_traverse_levels(TreeNode* root, Visitor visit,
             queue.push(nullptr);
         }
     }
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Orders of the traversal iterators
+enum class binary_tree_order { inorder, preorder, postorder, levels };
+
+/// ----------------------------------------------------------------------------
+/// @brief Forward iterator over the nodes of a binary tree in a given order.
+///
+/// The iterator carries the state of the iterative traversal (a stack of
+/// the ancestors in a binary_tree_stack, or the queue of the level-order),
+/// so a traversal can be stopped at any node, e.g. by std::find_if(), and
+/// resumed later. Neither the end iterator nor the copies of an iterator
+/// of the stack orders allocate memory (unless the tree is very deep). The
+/// default-constructed iterator is the end. The tree must not change while
+/// it is iterated.
+template <typename TreeNode, binary_tree_order Order>
+class binary_tree_iterator
+{
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = TreeNode;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = TreeNode*;
+    using reference         = TreeNode&;
+
+    /// @brief The end iterator
+    binary_tree_iterator() : left_(nullptr), right_(nullptr), head_(0) { }
+
+    /// @param[in]  root        root of the binary tree
+    /// @param[in]  left,right  [opt] pointers to left,right members
+    explicit
+    binary_tree_iterator(TreeNode* root,
+                         TreeNode* TreeNode::* left  = &TreeNode::left,
+                         TreeNode* TreeNode::* right = &TreeNode::right)
+        : left_(left), right_(right), head_(0)
+    {
+        if (!root) {
+            return;
+        }
+        if (Order == binary_tree_order::inorder) {
+            descend_left(root);
+        } else if (Order == binary_tree_order::postorder) {
+            descend_first(root);
+        } else if (Order == binary_tree_order::preorder) {
+            stack_.push(root);
+        } else {
+            queue_.push_back(root);
+        }
+    }
+
+    reference operator*() const { return *node(); }
+    pointer operator->() const { return node(); }
+
+    /// @return  the current node, null at the end
+    TreeNode* node() const
+    {
+        if (Order == binary_tree_order::levels) {
+            return head_ < queue_.size() ? queue_[head_] : nullptr;
+        }
+        return stack_.empty() ? nullptr : stack_.top();
+    }
+
+    binary_tree_iterator& operator++()
+    {
+        TreeNode* node = this->node();
+
+        switch (Order) {
+        case binary_tree_order::inorder:
+            // the next is the leftmost node of the right subtree,
+            // or the closest ancestor the node is on the left of
+            stack_.pop();
+            if (node->*right_) {
+                descend_left(node->*right_);
+            }
+            break;
+
+        case binary_tree_order::preorder:
+            stack_.pop();
+            if (node->*right_) {
+                stack_.push(node->*right_);
+            }
+            if (node->*left_) {
+                stack_.push(node->*left_);
+            }
+            break;
+
+        case binary_tree_order::postorder:
+            // the next is the parent, unless the node is the left child
+            // and there is a right subtree to visit first
+            stack_.pop();
+            if (!stack_.empty()) {
+                TreeNode* parent = stack_.top();
+                if (parent->*left_ == node && parent->*right_) {
+                    descend_first(parent->*right_);
+                }
+            }
+            break;
+
+        case binary_tree_order::levels:
+            // drop the visited half of the queue once it is the larger one
+            if (++head_ > queue_.size() / 2) {
+                queue_.erase(queue_.begin(), queue_.begin() + head_);
+                head_ = 0;
+            }
+            if (node->*left_) {
+                queue_.push_back(node->*left_);
+            }
+            if (node->*right_) {
+                queue_.push_back(node->*right_);
+            }
+            break;
+        }
+        return *this;
+    }
+
+    binary_tree_iterator operator++(int)
+    {
+        binary_tree_iterator it(*this);
+        ++*this;
+        return it;
+    }
+
+    bool operator==(const binary_tree_iterator& other) const
+    {
+        return node() == other.node();
+    }
+
+    bool operator!=(const binary_tree_iterator& other) const
+    {
+        return !(*this == other);
+    }
+
+private:
+    // pushes the path to the leftmost node
+    void descend_left(TreeNode* node)
+    {
+        for (; node; node = node->*left_) {
+            stack_.push(node);
+        }
+    }
+
+    // pushes the path to the first node in postorder: to the left
+    // whenever possible, otherwise to the right, down to a leaf
+    void descend_first(TreeNode* node)
+    {
+        while (node) {
+            stack_.push(node);
+            node = node->*left_ ? node->*left_ : node->*right_;
+        }
+    }
+
+    TreeNode* TreeNode::* left_;
+    TreeNode* TreeNode::* right_;
+    binary_tree_stack<TreeNode*> stack_;  // inorder, preorder, postorder
+    std::vector<TreeNode*> queue_;        // levels, from queue_[head_]
+    size_t head_;
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief A pair of iterators usable in range-based for loops
+template <typename Iterator>
+struct binary_tree_range
+{
+    Iterator first;
+    Iterator last;
+
+    Iterator begin() const { return first; }
+    Iterator end() const { return last; }
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Nodes of a binary tree in the inorder, as an iterator range
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 range of binary_tree_iterator
+template <typename TreeNode>
+binary_tree_range<binary_tree_iterator<TreeNode, binary_tree_order::inorder> >
+binary_tree_inorder(TreeNode* root,
+                    TreeNode* TreeNode::* left  = &TreeNode::left,
+                    TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    using iterator =
+        binary_tree_iterator<TreeNode, binary_tree_order::inorder>;
+    return { iterator(root, left, right), iterator() };
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Nodes of a binary tree in the preorder, as an iterator range
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 range of binary_tree_iterator
+template <typename TreeNode>
+binary_tree_range<binary_tree_iterator<TreeNode, binary_tree_order::preorder> >
+binary_tree_preorder(TreeNode* root,
+                     TreeNode* TreeNode::* left  = &TreeNode::left,
+                     TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    using iterator =
+        binary_tree_iterator<TreeNode, binary_tree_order::preorder>;
+    return { iterator(root, left, right), iterator() };
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Nodes of a binary tree in the postorder, as an iterator range
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 range of binary_tree_iterator
+template <typename TreeNode>
+binary_tree_range<binary_tree_iterator<TreeNode, binary_tree_order::postorder> >
+binary_tree_postorder(TreeNode* root,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    using iterator =
+        binary_tree_iterator<TreeNode, binary_tree_order::postorder>;
+    return { iterator(root, left, right), iterator() };
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Nodes of a binary tree level by level, as an iterator range
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 range of binary_tree_iterator
+template <typename TreeNode>
+binary_tree_range<binary_tree_iterator<TreeNode, binary_tree_order::levels> >
+binary_tree_levels(TreeNode* root,
+                   TreeNode* TreeNode::* left  = &TreeNode::left,
+                   TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    using iterator =
+        binary_tree_iterator<TreeNode, binary_tree_order::levels>;
+    return { iterator(root, left, right), iterator() };
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Inorder traversal of a binary tree that passes the depth of every
+///        node to the visitor, visit(node, depth). One stack of (node, depth)
+///        pairs with O(h) extra memory.
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  visit       visitor callback
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 false if the visitor stopped the traversal
+template <typename TreeNode, typename Visitor>
+bool
+binary_tree_traverse_inorder_depth(TreeNode* node, Visitor visit,
+                                   TreeNode* TreeNode::* left  = &TreeNode::left,
+                                   TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_stack<std::pair<TreeNode*, int> > stack;
+    int depth = 0;
+    while (node || !stack.empty()) {
+        if (node) {
+            stack.push(std::make_pair(node, depth));
+            node = node->*left;
+            depth++;
+        } else {
+            std::pair<TreeNode*, int> top = stack.top();
+            stack.pop();
+            node = top.first->*right;
+            depth = top.second + 1;
+            if (!binary_tree_visit(visit, top.first, top.second)) {
+                return false;
+            }
+        }
+    }
+    return true;
 }
 
 /// ----------------------------------------------------------------------------
@@ -626,7 +2373,7 @@ binary_tree_print_node(TreeNode* node,
                        std::ostream &out = std::cout,
                        DataType TreeNode::* data = &TreeNode::data)
 {
-    out << "(" << std::setfill('0') << std::setw(2) << node->data << ")";
+    out << "(" << std::setfill('0') << std::setw(2) << node->*data << ")";
 }
 
 /// ----------------------------------------------------------------------------
@@ -671,16 +2418,13 @@ binary_tree_print(TreeNode* root,
     if (!root)
         return;
 
-    // First we do inroder traversal and map every node to
-    // its inorder index. The inorder index is the column index in the diagram.
-    int icol = 0;
-    std::map<TreeNode*, int> col;
-    auto count_columns = [ & ](TreeNode *node) {
-        col[node] = icol++;
-    };
-    binary_tree_traverse_inorder(root, count_columns);
+    // The column of a node is its inorder index. Instead of a map of the
+    // columns, every level is printed by its own inorder traversal that
+    // counts the columns as it goes (the nodes of a level come in the
+    // left-to-right order), so the extra memory is O(h) besides the lines.
+    // The left child of a node at the level is the last node of the next
+    // level seen before it, the right child is the first one after it.
 
-    //
     std::stringstream ssline;   // current line (the line with nodes)
     std::stringstream ssnext;   // next line (the line with "/" and "\")
     std::stringstream ssspace, ssunder; // space and underscore blocks
@@ -698,45 +2442,66 @@ binary_tree_print(TreeNode* root,
     ssright << std::setw(nodewidth) << std::left  << "\\";
 
     int off = 0;
-    auto print = [ & ](TreeNode *node) {
-        if (node) {
-            // process a node
-            auto outline = std::ostream_iterator<std::string>(ssline);
-            auto outnext = std::ostream_iterator<std::string>(ssnext);
-            int cc = col[node];
-            int sp = cc - off;
-            int ls = (node->*left) ? (cc - col[node->*left]) : 0;
-            int rs = (node->*right) ? (col[node->*right] - cc) : 0;
-            std::fill_n(outline, sp - ls, ssspace.str());
-            std::fill_n(outnext, sp - ls, ssspace.str());
-            if (ls) {
-                std::fill_n(outline, 1, ssspace.str());
-                std::fill_n(outnext, 1, ssleft.str());
-                std::fill_n(outline, ls - 1, ssunder.str());
-                std::fill_n(outnext, ls - 1, ssspace.str());
-            }
-            printnode(node, ssline, data);
-            //printnode(node,0);
-            ssnext << ssspace.str();
-            if (rs) {
-                std::fill_n(outline, rs - 1, ssunder.str());
-                std::fill_n(outnext, rs - 1, ssspace.str());
-                std::fill_n(outline, 1, ssspace.str());
-                std::fill_n(outnext, 1, ssright.str());
-            }
-            off = col[node] + rs + 1;
-        } else {
-            // nullptr node => new level, print and reset the lines
-            outs << ssline.str() << std::endl;
-            outs << ssnext.str() << std::endl;
-            ssline.str("");
-            ssnext.str("");
-            off = 0;
+    auto print = [ & ](TreeNode *node, int cc, int ls, int rs) {
+        auto outline = std::ostream_iterator<std::string>(ssline);
+        auto outnext = std::ostream_iterator<std::string>(ssnext);
+        int sp = cc - off;
+        std::fill_n(outline, sp - ls, ssspace.str());
+        std::fill_n(outnext, sp - ls, ssspace.str());
+        if (ls) {
+            std::fill_n(outline, 1, ssspace.str());
+            std::fill_n(outnext, 1, ssleft.str());
+            std::fill_n(outline, ls - 1, ssunder.str());
+            std::fill_n(outnext, ls - 1, ssspace.str());
         }
+        printnode(node, ssline, data);
+        ssnext << ssspace.str();
+        if (rs) {
+            std::fill_n(outline, rs - 1, ssunder.str());
+            std::fill_n(outnext, rs - 1, ssspace.str());
+            std::fill_n(outline, 1, ssspace.str());
+            std::fill_n(outnext, 1, ssright.str());
+        }
+        off = cc + rs + 1;
     };
 
-    // at the end of the day, it's just a horizontal level traversal
-    binary_tree_traverse_levels(root, print);
+    bool more = true;
+    for (int level = 0; more; level++) {
+        int icol = 0;
+        int child = 0;               // column of the last node one level down
+        TreeNode* pending = nullptr; // node waiting for its right child
+        int pcol = 0, pls = 0;
+        more = false;
+
+        binary_tree_traverse_inorder_depth(root,
+            [ & ] (TreeNode *node, int depth) {
+                int cc = icol++;
+                if (depth == level + 1) {
+                    more = true;
+                    if (pending && pending->*right == node) {
+                        print(pending, pcol, pls, cc - pcol);
+                        pending = nullptr;
+                    }
+                    child = cc;
+                } else if (depth == level) {
+                    int ls = (node->*left) ? cc - child : 0;
+                    if (node->*right) {
+                        pending = node;
+                        pcol = cc;
+                        pls = ls;
+                    } else {
+                        print(node, cc, ls, 0);
+                    }
+                }
+            },
+            left, right);
+
+        outs << ssline.str() << std::endl;
+        outs << ssnext.str() << std::endl;
+        ssline.str("");
+        ssnext.str("");
+        off = 0;
+    }
 }
 
 } // namepace algo
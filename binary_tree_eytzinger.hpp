@@ -0,0 +1,187 @@
+/// ****************************************************************************
+///
+/// @file   : binary_tree_eytzinger.hpp
+/// @brief  : Flat (Eytzinger) layout of a binary search tree
+///
+/// @author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+///
+/// ****************************************************************************
+#ifndef ALGO_BINARY_TREE_EYTZINGER_HPP
+#define ALGO_BINARY_TREE_EYTZINGER_HPP
+
+#include <vector>
+#include <iterator>
+#include <functional>  // std::less
+#include <stdint.h>    // uintptr_t
+
+#include "binary_tree.hpp"
+
+namespace algo
+{
+
+/// ----------------------------------------------------------------------------
+/// @brief Read-only BST stored as an array in the Eytzinger (BFS) order: the
+///        root is at index 1, and the children of the node k are at 2k and
+///        2k+1. There are no pointers, the tree is complete, so the search
+///        makes exactly ~log2(n) steps, each of them a comparison that selects
+///        the next index arithmetically (no unpredictable branches), and the
+///        nodes of the next several levels are prefetched: the 16 descendants
+///        four levels below the node k (for 4-byte keys) are the cache line
+///        at 16k.
+template <typename T, typename Comparator = std::less<T> >
+class binary_tree_eytzinger
+{
+public:
+    using value_type = T;
+
+    /// @param[in]  comp  [opt] comparator the keys are sorted by
+    explicit binary_tree_eytzinger(Comparator comp = Comparator())
+        : comp_(comp), keys_(nullptr), size_(0) { }
+
+    /// @param[in]  first,last  sorted range of keys
+    /// @param[in]  comp        [opt] comparator the range is sorted by
+    template <typename Iterator>
+    binary_tree_eytzinger(Iterator first, Iterator last,
+                          Comparator comp = Comparator())
+        : comp_(comp), keys_(nullptr), size_(0)
+    {
+        assign(first, last);
+    }
+
+    binary_tree_eytzinger(binary_tree_eytzinger&&) = default;
+    binary_tree_eytzinger& operator=(binary_tree_eytzinger&&) = default;
+    binary_tree_eytzinger(const binary_tree_eytzinger&) = delete;
+    binary_tree_eytzinger& operator=(const binary_tree_eytzinger&) = delete;
+
+    /// @brief Builds the layout from a sorted range. O(n)
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        size_ = std::distance(first, last);
+
+        // index 0 is unused; the array is aligned to a cache line, so
+        // the children of the nodes of a line are whole lines too
+        const size_t line = cache_line / sizeof(T) ? cache_line / sizeof(T) : 1;
+        storage_.assign(size_ + 1 + line, T());
+        uintptr_t addr = reinterpret_cast<uintptr_t>(storage_.data());
+        size_t offset = (cache_line - addr % cache_line) % cache_line;
+        keys_ = storage_.data() + (offset % sizeof(T) ? 0 : offset / sizeof(T));
+
+        fill(first, 1);
+    }
+
+    /// @brief Builds the layout from the nodes of a BST. O(n)
+    ///
+    /// @param[in]  root             root of the BST
+    /// @param[in]  data,left,right  [opt] pointers to data,left,right members
+    template <typename TreeNode,
+              typename DataType = typename TreeNode::data_type>
+    void assign_tree(TreeNode* root,
+                     DataType  TreeNode::* data  = &TreeNode::data,
+                     TreeNode* TreeNode::* left  = &TreeNode::left,
+                     TreeNode* TreeNode::* right = &TreeNode::right)
+    {
+        std::vector<T> sorted;
+        binary_tree_traverse_inorder(root,
+                                     [ & ] (TreeNode* node) {
+                                         sorted.push_back(node->*data);
+                                     },
+                                     left, right);
+        assign(sorted.begin(), sorted.end());
+    }
+
+    size_t size() const { return size_; }
+
+    /// @return  the smallest key not less than value, null if there is none
+    const T* lower_bound(const T& value) const
+    {
+        size_t k = 1;
+        while (k <= size_) {
+            prefetch(keys_ + k * prefetch_stride);
+            k = 2 * k + comp_(keys_[k], value);
+        }
+        // k went left for the last time at the answer, and right ever since:
+        // drop those right turns (trailing ones) and the last left turn
+        k >>= trailing_ones(k) + 1;
+        return k ? keys_ + k : nullptr;
+    }
+
+    /// @return  the key equal to value, if exists, null otherwise
+    const T* search(const T& value) const
+    {
+        const T* key = lower_bound(value);
+        return (key && !comp_(value, *key)) ? key : nullptr;
+    }
+
+private:
+    static const size_t cache_line = 64;
+    // the descendants of k four levels down (for 4-byte keys) start at 16k
+    static const size_t prefetch_stride =
+        cache_line / sizeof(T) ? cache_line / sizeof(T) : 1;
+
+    template <typename Iterator>
+    Iterator fill(Iterator it, size_t k)
+    {
+        // inorder walk of the implicit tree
+        if (k <= size_) {
+            it = fill(it, 2 * k);
+            keys_[k] = *it++;
+            it = fill(it, 2 * k + 1);
+        }
+        return it;
+    }
+
+    static void prefetch(const T* p)
+    {
+#if defined(__GNUC__)
+        __builtin_prefetch(p);
+#else
+        (void)p;
+#endif
+    }
+
+    static int trailing_ones(size_t k)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(~(unsigned long long)k);
+#else
+        int n = 0;
+        while (k & 1) {
+            k >>= 1;
+            n++;
+        }
+        return n;
+#endif
+    }
+
+    Comparator comp_;
+    std::vector<T> storage_;
+    T* keys_;      // keys_[1..size_], inside storage_
+    size_t size_;
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Flat Eytzinger layout of a BST (see binary_tree_eytzinger)
+///
+/// @param[in]  root             root of the BST
+/// @param[in]  comp             [opt] comparator the BST is ordered by
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      the layout
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+binary_tree_eytzinger<DataType, Comparator>
+binary_tree_to_eytzinger(TreeNode* root,
+                         Comparator comp = Comparator(),
+                         DataType  TreeNode::* data  = &TreeNode::data,
+                         TreeNode* TreeNode::* left  = &TreeNode::left,
+                         TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_eytzinger<DataType, Comparator> flat(comp);
+    flat.assign_tree(root, data, left, right);
+    return flat;
+}
+
+} // namepace algo
+
+#endif
@@ -0,0 +1,325 @@
+/// ****************************************************************************
+///
+/// @file   : binary_tree_parallel.hpp
+/// @brief  : Parallel fork-join reductions over binary trees
+///
+/// @author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+///
+/// ****************************************************************************
+#ifndef ALGO_BINARY_TREE_PARALLEL_HPP
+#define ALGO_BINARY_TREE_PARALLEL_HPP
+
+#include <vector>
+#include <memory>      // std::unique_ptr
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>   // std::exception_ptr
+#include <algorithm>   // std::max()
+#include <functional>  // std::less
+#include <stdlib.h>    // abs()
+
+#include "binary_tree.hpp"
+
+namespace algo
+{
+
+/// ----------------------------------------------------------------------------
+/// @brief Runs func(i) for i in [0, count) on nthreads threads (the calling
+///        one included). The threads take the next index from a shared
+///        counter, so uneven tasks are balanced dynamically. If a thread
+///        can't be started or a task throws, the remaining tasks are skipped,
+///        all the started threads are joined and the first exception is
+///        rethrown on the calling thread.
+///
+/// @param[in]  count     number of tasks
+/// @param[in]  nthreads  number of threads
+/// @param[in]  func      task callback
+/// @return               void
+template <typename Func>
+void
+binary_tree_run_parallel(size_t count, unsigned nthreads, Func func)
+{
+    std::atomic<size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [ & ] () {
+        try {
+            for (size_t i = next++; i < count; i = next++) {
+                func(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            next = count;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(std::min<size_t>(nthreads, count));
+        for (unsigned t = 1; t < nthreads && t < count; t++) {
+            threads.emplace_back(worker);
+        }
+    } catch (...) {
+        next = count;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        throw;
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Number of threads to use and the depth at which a tree is cut into
+///        tasks: ~8 tasks per thread, so that the threads that get smaller
+///        subtrees take more of them. Below the cutoff, every subtree is
+///        processed sequentially.
+///
+/// @param[in,out]  nthreads  number of threads, 0 = all the cores
+/// @return                   depth of the cutoff, 0 = no split
+inline int
+binary_tree_parallel_cutoff(unsigned& nthreads)
+{
+    if (nthreads == 0) {
+        nthreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    int depth = 0;
+    while (nthreads > 1 && (1u << depth) < 8 * nthreads && depth < 20) {
+        depth++;
+    }
+    return depth;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Cuts a binary tree at a given depth: collects the subtrees at that
+///        depth (the tasks, null ones included) and the nodes above it,
+///        both in preorder
+///
+/// @param[in]  node        root of the binary tree
+/// @param[in]  depth       depth of the cut
+/// @param[out] tasks       roots of the subtrees at the depth
+/// @param[out] top         [opt] nodes above the depth
+/// @param[in]  left,right  pointers to left,right members
+/// @return                 void
+template <typename TreeNode>
+void
+binary_tree_split(TreeNode* node, int depth,
+                  std::vector<TreeNode*>& tasks,
+                  std::vector<TreeNode*>* top,
+                  TreeNode* TreeNode::* left,
+                  TreeNode* TreeNode::* right)
+{
+    if (!node || depth == 0) {
+        tasks.push_back(node);
+        return;
+    }
+    if (top) {
+        top->push_back(node);
+    }
+    binary_tree_split(node->*left, depth - 1, tasks, top, left, right);
+    binary_tree_split(node->*right, depth - 1, tasks, top, left, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Combines the results of the subtrees below the cut (see
+///        binary_tree_split) up to the root
+template <typename TreeNode, typename Result, typename Combine>
+Result
+binary_tree_combine(TreeNode* node, int depth, Result*& results,
+                    Combine& combine,
+                    TreeNode* TreeNode::* left,
+                    TreeNode* TreeNode::* right)
+{
+    if (!node || depth == 0) {
+        return *results++;
+    }
+    Result l = binary_tree_combine(node->*left, depth - 1, results, combine,
+                                   left, right);
+    Result r = binary_tree_combine(node->*right, depth - 1, results, combine,
+                                   left, right);
+    return combine(node, l, r);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Parallel fork-join reduction of a binary tree.
+///
+/// The tree is cut at a small depth (binary_tree_parallel_cutoff) into
+/// subtrees, which are reduced by subtree() in parallel, then the results
+/// are combined by combine() up to the root on the calling thread.
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  subtree     Result subtree(TreeNode* node): sequential
+///                         reduction of the subtree of node (may be null)
+/// @param[in]  combine     Result combine(TreeNode* node, Result left,
+///                         Result right): result of the subtree of node
+///                         from the results of its children
+/// @param[in]  nthreads    [opt] number of threads, 0 = all the cores
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 result for the whole tree
+template <typename Result, typename TreeNode,
+          typename Subtree, typename Combine>
+Result
+binary_tree_parallel_reduce(TreeNode* root, Subtree subtree, Combine combine,
+                            unsigned nthreads = 0,
+                            TreeNode* TreeNode::* left  = &TreeNode::left,
+                            TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    const int depth = binary_tree_parallel_cutoff(nthreads);
+
+    std::vector<TreeNode*> tasks;
+    binary_tree_split(root, depth, tasks,
+                      static_cast<std::vector<TreeNode*>*>(nullptr),
+                      left, right);
+
+    // a plain array: the threads write their own elements
+    // (std::vector<bool> would pack them into shared words)
+    std::unique_ptr<Result[]> results(new Result[tasks.size()]);
+    binary_tree_run_parallel(tasks.size(), nthreads, [ & ] (size_t i) {
+            results[i] = subtree(tasks[i]);
+        });
+
+    Result* next = results.get();
+    return binary_tree_combine(root, depth, next, combine, left, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Parallel check if a given BT is a BST.
+///
+/// @param[in]  root             root of the binary tree
+/// @param[in]  comp             [opt] comparator used to compare two nodes
+/// @param[in]  nthreads         [opt] number of threads, 0 = all the cores
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      true if BST, false otherwise
+template <typename TreeNode,
+          typename DataType = typename TreeNode::data_type,
+          typename Comparator = std::less<DataType> >
+bool
+binary_tree_is_bst_parallel(TreeNode* root,
+                            Comparator comp = Comparator(),
+                            unsigned nthreads = 0,
+                            DataType  TreeNode::* data  = &TreeNode::data,
+                            TreeNode* TreeNode::* left  = &TreeNode::left,
+                            TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    // a subtree is a BST with the smallest and the largest nodes
+    struct result {
+        bool is_bst;
+        TreeNode* min;
+        TreeNode* max;
+    };
+
+    // once a subtree is found not to be a BST, the others are skipped
+    std::atomic<bool> failed(false);
+
+    auto subtree = [ & ] (TreeNode* node) {
+        result r = { true, nullptr, nullptr };
+        if (failed) {
+            r.is_bst = false;
+            return r;
+        }
+        binary_tree_traverse_inorder(node, [ & ] (TreeNode* n) {
+                if (r.max) {
+                    r.is_bst = comp(r.max->*data, n->*data);
+                }
+                if (!r.min) {
+                    r.min = n;
+                }
+                r.max = n;
+                return r.is_bst;
+            }, left, right);
+        if (!r.is_bst) {
+            failed = true;
+        }
+        return r;
+    };
+
+    auto combine = [ & ] (TreeNode* node, result l, result r) {
+        result c;
+        c.is_bst = l.is_bst && r.is_bst &&
+                   (!l.max || comp(l.max->*data, node->*data)) &&
+                   (!r.min || comp(node->*data, r.min->*data));
+        c.min = l.min ? l.min : node;
+        c.max = r.max ? r.max : node;
+        return c;
+    };
+
+    return binary_tree_parallel_reduce<result>(root, subtree, combine,
+                                               nthreads, left, right).is_bst;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Parallel check if a given BT is a balanced BT
+///
+/// @param[in]  root        root of the binary tree
+/// @param[in]  nthreads    [opt] number of threads, 0 = all the cores
+/// @param[in]  left,right  [opt] pointers to left,right members
+/// @return                 true if BT is balanced, false otherwise
+template <typename TreeNode>
+bool
+binary_tree_is_balanced_parallel(TreeNode* root,
+                                 unsigned nthreads = 0,
+                                 TreeNode* TreeNode::* left  = &TreeNode::left,
+                                 TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    std::atomic<bool> failed(false);
+
+    // height of a balanced subtree, -1 otherwise
+    auto subtree = [ & ] (TreeNode* node) {
+        int h = failed ? -1 : binary_tree_balanced_height(node, left, right);
+        if (h < 0) {
+            failed = true;
+        }
+        return h;
+    };
+
+    auto combine = [ ] (TreeNode*, int l, int r) {
+        return (l < 0 || r < 0 || std::abs(l - r) > 1) ?
+            -1 : std::max(l, r) + 1;
+    };
+
+    return binary_tree_parallel_reduce<int>(root, subtree, combine,
+                                            nthreads, left, right) >= 0;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Destroys a binary tree in parallel: the subtrees below the cut
+///        concurrently, then the nodes above it
+///
+/// @param[in]  root             root of the binary tree
+/// @param[in]  nthreads         [opt] number of threads, 0 = all the cores
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      void
+template <typename TreeNode, typename DataType = typename TreeNode::data_type>
+void
+binary_tree_destroy_tree_parallel(TreeNode* root,
+                                  unsigned nthreads = 0,
+                                  DataType TreeNode::*data = &TreeNode::data,
+                                  TreeNode* TreeNode::*left = &TreeNode::left,
+                                  TreeNode* TreeNode::*right = &TreeNode::right)
+{
+    const int depth = binary_tree_parallel_cutoff(nthreads);
+
+    std::vector<TreeNode*> tasks, top;
+    binary_tree_split(root, depth, tasks, &top, left, right);
+
+    binary_tree_run_parallel(tasks.size(), nthreads, [ & ] (size_t i) {
+            binary_tree_destroy_tree(tasks[i], data, left, right);
+        });
+    for (TreeNode* node : top) {
+        binary_tree_destroy_node(node, data);
+    }
+}
+
+} // namepace algo
+
+#endif
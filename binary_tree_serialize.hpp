@@ -0,0 +1,399 @@
+/// ****************************************************************************
+///
+/// @file   : binary_tree_serialize.hpp
+/// @brief  : Compact binary serialization of binary trees
+///
+/// @author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+///
+/// ****************************************************************************
+#ifndef ALGO_BINARY_TREE_SERIALIZE_HPP
+#define ALGO_BINARY_TREE_SERIALIZE_HPP
+
+#include <vector>
+#include <cstring>      // std::memcpy(), std::memcmp()
+#include <type_traits>  // std::is_trivially_copyable
+#include <functional>   // std::less
+#include <stdint.h>     // uint32_t, uint64_t, uintptr_t
+
+#include "binary_tree.hpp"
+
+namespace algo
+{
+
+/// ----------------------------------------------------------------------------
+/// @brief Header of a serialized binary tree.
+///
+/// The header is followed by the shape of the tree: 2 bits per node in
+/// preorder (bit 2i: the node i has a left child, bit 2i+1: a right one) in
+/// 64-bit words, and then by the data of the nodes in preorder, as is. The
+/// data starts and the tree ends at multiples of the alignment of the data
+/// (8 bytes at least) from the start of the tree, so a tree of n nodes takes
+/// about 16 + 8 * ceil(n / 32) + n * sizeof(data) bytes, and the trees
+/// appended to a buffer one after another stay aligned.
+///
+/// The data must be trivially copyable, and is stored in the byte order and
+/// layout of the machine: the format is for checkpoints and for exchange
+/// between processes of the same build, not a portable one.
+struct binary_tree_serial_header
+{
+    char     magic[4];   // "BTS1"
+    uint32_t data_size;  // sizeof the data of a node
+    uint64_t nodes;
+};
+
+/// ----------------------------------------------------------------------------
+/// @brief Rounds a size up to a multiple of the alignment of serialized data
+///
+/// @param[in]  size        size in bytes
+/// @param[in]  data_align  alignof the data of a node
+/// @return                 the size rounded up
+inline size_t
+binary_tree_serial_align(size_t size, size_t data_align)
+{
+    const size_t align = data_align > 8 ? data_align : 8;
+    return (size + align - 1) / align * align;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Bits of a node in the shape of a serialized tree. The shape is read
+///        by bytes, so it needs no alignment.
+///
+/// @param[in]  shape  shape bits
+/// @param[in]  i      index of the node
+/// @return            bit 0: has a left child, bit 1: has a right child
+inline unsigned
+binary_tree_shape_bits(const char* shape, size_t i)
+{
+    uint64_t word;
+    std::memcpy(&word, shape + i / 32 * sizeof(word), sizeof(word));
+    return (word >> (2 * (i % 32))) & 3;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Finds the shape and the data of a serialized tree in a buffer
+///
+/// @param[in]  buf,len     serialized tree
+/// @param[in]  data_size   expected sizeof the data of a node
+/// @param[in]  data_align  alignof the data of a node
+/// @param[out] nodes       number of nodes
+/// @param[out] shape       shape bits
+/// @param[out] data        data of the nodes
+/// @return                 false if the buffer doesn't hold such a tree
+inline bool
+binary_tree_serial_layout(const char* buf, size_t len,
+                          size_t data_size, size_t data_align,
+                          size_t& nodes,
+                          const char*& shape, const char*& data)
+{
+    binary_tree_serial_header header;
+    if (len < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, buf, sizeof(header));
+    if (std::memcmp(header.magic, "BTS1", 4) != 0 ||
+        header.data_size != data_size) {
+        return false;
+    }
+
+    // sizes checked against the buffer before multiplied
+    size_t words = header.nodes / 32 + (header.nodes % 32 != 0);
+    if (words > (len - sizeof(header)) / 8) {
+        return false;
+    }
+    size_t offset = binary_tree_serial_align(sizeof(header) + words * 8,
+                                             data_align);
+    if (offset > len ||
+        (data_size && header.nodes > (len - offset) / data_size) ||
+        binary_tree_serial_align(offset + header.nodes * data_size,
+                                 data_align) > len) {
+        return false;
+    }
+    nodes = header.nodes;
+    shape = buf + sizeof(header);
+    data = buf + offset;
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Serializes a binary tree. O(n), one preorder traversal.
+///
+/// @param[in]  root             root of the binary tree (may be null)
+/// @param[out] out              buffer the tree is appended to (the tree is
+///                              aligned if the buffer size is a multiple of
+///                              8 and of alignof the data)
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      number of bytes appended (padded)
+template <typename TreeNode, typename DataType = typename TreeNode::data_type>
+size_t
+binary_tree_serialize(TreeNode* root, std::vector<char>& out,
+                      DataType  TreeNode::* data  = &TreeNode::data,
+                      TreeNode* TreeNode::* left  = &TreeNode::left,
+                      TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    static_assert(std::is_trivially_copyable<DataType>::value,
+                  "the data must be trivially copyable");
+
+    std::vector<uint64_t> shape;
+    std::vector<DataType> values;
+    binary_tree_traverse_preorder(root, [ & ] (TreeNode* node) {
+            size_t bit = 2 * (values.size() % 32);
+            if (bit == 0) {
+                shape.push_back(0);
+            }
+            shape.back() |= uint64_t(node->*left  != nullptr) << bit |
+                            uint64_t(node->*right != nullptr) << (bit + 1);
+            values.push_back(node->*data);
+        }, left, right);
+
+    binary_tree_serial_header header = { { 'B', 'T', 'S', '1' },
+                                         uint32_t(sizeof(DataType)),
+                                         uint64_t(values.size()) };
+    const size_t align = alignof(DataType);
+    size_t start = out.size();
+    size_t offset = binary_tree_serial_align(
+        sizeof(header) + shape.size() * sizeof(uint64_t), align);
+    size_t bytes = binary_tree_serial_align(
+        offset + values.size() * sizeof(DataType), align);
+    out.resize(start + bytes);  // the padding is zeroed
+
+    char* p = out.data() + start;
+    std::memcpy(p, &header, sizeof(header));
+    if (!shape.empty()) {
+        std::memcpy(p + sizeof(header), shape.data(),
+                    shape.size() * sizeof(uint64_t));
+        std::memcpy(p + offset, values.data(),
+                    values.size() * sizeof(DataType));
+    }
+    return bytes;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Decodes the shape of a serialized tree: makes the nodes in preorder
+///        and links every one of them but the root to its parent
+///
+/// @param[in]  shape  shape bits (see binary_tree_serial_header)
+/// @param[in]  nodes  number of nodes
+/// @param[in]  make   Node make(size_t i): makes the i-th node
+/// @param[in]  link   link(Node parent, bool left, Node child)
+/// @return            false if the shape is malformed
+template <typename Node, typename Make, typename Link>
+bool
+binary_tree_decode_shape(const char* shape, size_t nodes,
+                         Make make, Link link)
+{
+    // the nodes that are still to get their right children
+    binary_tree_stack<Node> pending;
+    Node parent = Node();
+    bool has_parent = false, to_left = false;
+
+    for (size_t i = 0; i < nodes; i++) {
+        if (i > 0 && !has_parent) {
+            return false;
+        }
+        Node node = make(i);
+        if (i > 0) {
+            link(parent, to_left, node);
+        }
+
+        unsigned bits = binary_tree_shape_bits(shape, i);
+        if (bits & 2) {
+            pending.push(node);
+        }
+        has_parent = true;
+        if (bits & 1) {
+            parent = node;
+            to_left = true;
+        } else if (!pending.empty()) {
+            parent = pending.top();
+            pending.pop();
+            to_left = false;
+        } else {
+            has_parent = false;
+        }
+    }
+    // no children missing
+    return !has_parent;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Loads a serialized binary tree into nodes created with a given
+///        allocator. O(n). The nodes are created in preorder, so with
+///        binary_tree_node_pool they take one contiguous block.
+///
+/// @param[in]  alloc            node allocator
+/// @param[in]  buf,len          serialized tree
+/// @param[out] root             root of the loaded tree (null if empty)
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      false if the buffer is not a serialized tree
+///                              of such nodes (nothing is loaded then)
+template <typename Allocator,
+          typename TreeNode,
+          typename DataType = typename TreeNode::data_type>
+bool
+binary_tree_deserialize(Allocator &alloc, const char* buf, size_t len,
+                        TreeNode*& root,
+                        DataType  TreeNode::* data  = &TreeNode::data,
+                        TreeNode* TreeNode::* left  = &TreeNode::left,
+                        TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    static_assert(std::is_trivially_copyable<DataType>::value,
+                  "the data must be trivially copyable");
+
+    root = nullptr;
+    size_t nodes;
+    const char* shape;
+    const char* values;
+    if (!binary_tree_serial_layout(buf, len, sizeof(DataType),
+                                   alignof(DataType), nodes, shape, values)) {
+        return false;
+    }
+
+    alloc.reserve(nodes);
+    auto make = [ & ] (size_t i) {
+        TreeNode* node = alloc.allocate();
+        std::memcpy(&(node->*data), values + i * sizeof(DataType),
+                    sizeof(DataType));
+        node->*left  = nullptr;
+        node->*right = nullptr;
+        if (i == 0) {
+            root = node;
+        }
+        return node;
+    };
+    auto link = [ & ] (TreeNode* parent, bool to_left, TreeNode* child) {
+        parent->*(to_left ? left : right) = child;
+    };
+
+    if (!binary_tree_decode_shape<TreeNode*>(shape, nodes, make, link)) {
+        binary_tree_destroy_tree(alloc, root, data, left, right);
+        root = nullptr;
+        return false;
+    }
+    return true;
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Loads a serialized binary tree. O(n).
+///
+/// @param[in]  buf,len          serialized tree
+/// @param[out] root             root of the loaded tree (null if empty)
+/// @param[in]  data,left,right  [opt] pointers to data,left,right members
+/// @return                      false if the buffer is not a serialized tree
+template <typename TreeNode, typename DataType = typename TreeNode::data_type>
+bool
+binary_tree_deserialize(const char* buf, size_t len, TreeNode*& root,
+                        DataType  TreeNode::* data  = &TreeNode::data,
+                        TreeNode* TreeNode::* left  = &TreeNode::left,
+                        TreeNode* TreeNode::* right = &TreeNode::right)
+{
+    binary_tree_heap_allocator<TreeNode> heap;
+    return binary_tree_deserialize(heap, buf, len, root, data, left, right);
+}
+
+/// ----------------------------------------------------------------------------
+/// @brief Read-only binary tree over a serialized one, e.g. a file mapped
+///        into memory: the data is used in place, not copied. The nodes are
+///        indices in preorder, the left child of a node is the next one, and
+///        the right children are found once by open(), O(n) time and
+///        4 bytes per node.
+template <typename T>
+class binary_tree_serial_view
+{
+public:
+    using value_type = T;
+
+    // index of a missing node
+    static const uint32_t npos = uint32_t(-1);
+
+    binary_tree_serial_view() : shape_(nullptr), data_(nullptr), size_(0) { }
+
+    /// @brief Opens a serialized tree. The buffer must outlive the view, and
+    ///        the tree must be aligned for T (as mmap() and operator new
+    ///        results, and the trees appended after them, are).
+    ///
+    /// @param[in]  buf,len  serialized tree (of less than 2^32 - 1 nodes)
+    /// @return              false if the buffer is not a serialized tree of T
+    bool open(const char* buf, size_t len)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "the data must be trivially copyable");
+
+        size_t nodes;
+        const char* shape;
+        const char* data;
+        if (!binary_tree_serial_layout(buf, len, sizeof(T), alignof(T),
+                                       nodes, shape, data) ||
+            nodes >= npos ||
+            reinterpret_cast<uintptr_t>(data) % alignof(T) != 0) {
+            return false;
+        }
+
+        right_.assign(nodes, npos);
+        auto make = [ ] (size_t i) { return uint32_t(i); };
+        auto link = [ & ] (uint32_t parent, bool to_left, uint32_t child) {
+            if (!to_left) {
+                right_[parent] = child;
+            }
+        };
+        if (!binary_tree_decode_shape<uint32_t>(shape, nodes, make, link)) {
+            right_.clear();
+            return false;
+        }
+        shape_ = shape;
+        data_ = reinterpret_cast<const T*>(data);
+        size_ = nodes;
+        return true;
+    }
+
+    /// @return  number of nodes
+    size_t size() const { return size_; }
+
+    /// @return  index of the root, npos if the tree is empty
+    uint32_t root() const { return size_ ? 0 : npos; }
+
+    /// @return  index of the left child of node i, npos if there is none
+    uint32_t left(uint32_t i) const
+    {
+        return (binary_tree_shape_bits(shape_, i) & 1) ? i + 1 : npos;
+    }
+
+    /// @return  index of the right child of node i, npos if there is none
+    uint32_t right(uint32_t i) const { return right_[i]; }
+
+    /// @return  data of node i
+    const T& data(uint32_t i) const { return data_[i]; }
+
+    /// @brief Searches a value, if the tree is a BST. O(height).
+    ///
+    /// @param[in]  value  value to search for
+    /// @param[in]  comp   [opt] comparator the tree is ordered by
+    /// @return            index of the node with the value, npos if none
+    template <typename Comparator = std::less<T> >
+    uint32_t search(const T& value, Comparator comp = Comparator()) const
+    {
+        uint32_t i = root();
+        while (i != npos) {
+            if (comp(value, data_[i])) {
+                i = left(i);
+            } else if (comp(data_[i], value)) {
+                i = right_[i];
+            } else {
+                break;
+            }
+        }
+        return i;
+    }
+
+private:
+    const char* shape_;
+    const T* data_;
+    size_t size_;
+    std::vector<uint32_t> right_;
+};
+
+template <typename T>
+const uint32_t binary_tree_serial_view<T>::npos;
+
+} // namepace algo
+
+#endif
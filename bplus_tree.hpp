@@ -0,0 +1,341 @@
+/// ****************************************************************************
+///
+/// @file   : bplus_tree.hpp
+/// @brief  : Cache-conscious B+ tree
+///
+/// @author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+///
+/// ****************************************************************************
+#ifndef ALGO_BPLUS_TREE_HPP
+#define ALGO_BPLUS_TREE_HPP
+
+#include <cstddef>
+#include <functional>  // std::less
+#include <algorithm>   // std::move(), std::move_backward()
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "algo.hpp"
+
+namespace algo
+{
+
+/// ----------------------------------------------------------------------------
+/// @brief Counts the keys of a node less than a given value. Branch-free, so
+///        it costs the same wherever the value falls.
+///
+/// @param[in]  keys   sorted keys of the node
+/// @param[in]  n      number of the keys
+/// @param[in]  value  value to compare to
+/// @param[in]  comp   comparator
+/// @return            number of the keys less than the value
+template <typename T, typename Comparator>
+int
+bplus_tree_count_less(const T* keys, int n, const T& value, Comparator comp)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        count += comp(keys[i], value);
+    }
+    return count;
+}
+
+#if defined(__SSE2__)
+/// ----------------------------------------------------------------------------
+/// @brief Counts the keys of a node less than a given value, 4 at a time
+///        with SSE2 (32-bit keys ordered by std::less)
+inline int
+bplus_tree_count_less(const int* keys, int n, const int& value, std::less<int>)
+{
+    const __m128i v = _mm_set1_epi32(value);
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys + i));
+        // the lanes where key < value are -1
+        acc = _mm_sub_epi32(acc, _mm_cmplt_epi32(k, v));
+    }
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    int count = _mm_cvtsi128_si32(acc);
+    for (; i < n; i++) {
+        count += keys[i] < value;
+    }
+    return count;
+}
+#endif
+
+/// ----------------------------------------------------------------------------
+/// @brief B+ tree: a set of values ordered by a comparator, the counterpart
+///        of a BST built by binary_tree_insert_bst for large sets.
+///
+/// A node holds up to NodeBytes of sorted keys (a few cache lines) that are
+/// searched as a whole without branches (with SIMD for 32-bit integers),
+/// so a search touches log_B(n) nodes with B ~ NodeBytes / sizeof(T) instead
+/// of log_2(n) scattered BST nodes. All the values are in the leaves, and the
+/// leaves are linked for range scans.
+///
+/// The key of an inner node is the largest key of the subtree on its left:
+/// children[i] <= keys[i] < children[i + 1], so the child to descend to is
+/// the number of keys less than the value.
+template <typename T,
+          typename Comparator = std::less<T>,
+          size_t NodeBytes = 256>
+class bplus_tree
+{
+public:
+    using value_type = T;
+
+    // maximum number of keys in a node
+    static const int capacity =
+        NodeBytes / sizeof(T) >= 4 ? NodeBytes / sizeof(T) : 4;
+
+    /// @param[in]  comp  [opt] comparator
+    explicit bplus_tree(Comparator comp = Comparator())
+        : comp_(comp), root_(nullptr), size_(0), height_(0) { }
+
+    ~bplus_tree() { clear(); }
+
+    bplus_tree(const bplus_tree&) = delete;
+    bplus_tree& operator=(const bplus_tree&) = delete;
+
+    /// @brief Inserts a value. O(B logN / logB)
+    ///
+    /// @param[in]  value  a new value to be inserted
+    /// @return            true if inserted, false if the value exists
+    bool insert(const T& value)
+    {
+        if (!root_) {
+            root_ = new_leaf();
+            height_ = 1;
+        }
+
+        node* split = nullptr;
+        T sep;
+        if (!insert(root_, value, split, sep)) {
+            TDEBUG(("value already exists: %s\n") % value);
+            return false;
+        }
+        size_++;
+
+        if (split) {
+            // the root has split, grow a new one
+            inner_node* root = new inner_node();
+            root->leaf = false;
+            root->count = 1;
+            root->keys[0] = sep;
+            root->children[0] = root_;
+            root->children[1] = split;
+            root_ = root;
+            height_++;
+        }
+        return true;
+    }
+
+    /// @brief Searches a given value. O(logN)
+    ///
+    /// @param[in]  value  value to search for
+    /// @return            the value in the tree, if exists, null otherwise
+    ///                    (valid until the next insert)
+    const T* search(const T& value) const
+    {
+        const leaf_node* leaf = find_leaf(value);
+        if (!leaf) {
+            return nullptr;
+        }
+        int i = bplus_tree_count_less(leaf->keys, leaf->count, value, comp_);
+        return (i < leaf->count && !comp_(value, leaf->keys[i])) ?
+            leaf->keys + i : nullptr;
+    }
+
+    /// @brief Visits the values in [lo, hi) in order. O(logN + k)
+    ///
+    /// @param[in]  lo,hi  range of values
+    /// @param[in]  visit  visitor callback, called with a const T&
+    /// @return            void
+    template <typename Visitor>
+    void range(const T& lo, const T& hi, Visitor visit) const
+    {
+        const leaf_node* leaf = find_leaf(lo);
+        if (!leaf) {
+            return;
+        }
+        int i = bplus_tree_count_less(leaf->keys, leaf->count, lo, comp_);
+        for (; leaf; leaf = leaf->next, i = 0) {
+            for (; i < leaf->count; i++) {
+                if (!comp_(leaf->keys[i], hi)) {
+                    return;
+                }
+                visit(leaf->keys[i]);
+            }
+        }
+    }
+
+    /// @return  number of values
+    size_t size() const { return size_; }
+
+    /// @return  number of levels, 0 if empty
+    int height() const { return height_; }
+
+    /// @brief Removes all the values
+    void clear()
+    {
+        destroy(root_);
+        root_ = nullptr;
+        size_ = 0;
+        height_ = 0;
+    }
+
+private:
+    struct node
+    {
+        int count;
+        bool leaf;
+        T keys[capacity];
+    };
+
+    struct inner_node : node
+    {
+        node* children[capacity + 1];
+    };
+
+    struct leaf_node : node
+    {
+        leaf_node* next;
+    };
+
+    static leaf_node* new_leaf()
+    {
+        leaf_node* leaf = new leaf_node();
+        leaf->leaf = true;
+        leaf->count = 0;
+        leaf->next = nullptr;
+        return leaf;
+    }
+
+    static void insert_at(node* n, int i, const T& value)
+    {
+        std::move_backward(n->keys + i, n->keys + n->count,
+                           n->keys + n->count + 1);
+        n->keys[i] = value;
+        n->count++;
+    }
+
+    const leaf_node* find_leaf(const T& value) const
+    {
+        const node* n = root_;
+        if (!n) {
+            return nullptr;
+        }
+        while (!n->leaf) {
+            int i = bplus_tree_count_less(n->keys, n->count, value, comp_);
+            n = static_cast<const inner_node*>(n)->children[i];
+        }
+        return static_cast<const leaf_node*>(n);
+    }
+
+    // Inserts a value into the subtree of n. If n has to split, split is
+    // set to the new right half and sep to the largest key of the left one.
+    bool insert(node* n, const T& value, node*& split, T& sep)
+    {
+        int i = bplus_tree_count_less(n->keys, n->count, value, comp_);
+
+        if (n->leaf) {
+            if (i < n->count && !comp_(value, n->keys[i])) {
+                return false;
+            }
+            if (n->count < capacity) {
+                insert_at(n, i, value);
+                return true;
+            }
+
+            // split a full leaf in halves
+            leaf_node* left = static_cast<leaf_node*>(n);
+            leaf_node* right = new_leaf();
+            const int half = capacity / 2;
+            std::move(left->keys + half, left->keys + capacity, right->keys);
+            right->count = capacity - half;
+            left->count = half;
+            right->next = left->next;
+            left->next = right;
+
+            if (i < half) {
+                insert_at(left, i, value);
+            } else {
+                insert_at(right, i - half, value);
+            }
+            sep = left->keys[left->count - 1];
+            split = right;
+            return true;
+        }
+
+        inner_node* inner = static_cast<inner_node*>(n);
+        node* csplit = nullptr;
+        T csep;
+        if (!insert(inner->children[i], value, csplit, csep)) {
+            return false;
+        }
+        if (!csplit) {
+            return true;
+        }
+
+        // the child has split: csep goes to keys[i], csplit to children[i+1]
+        inner_node* target = inner;
+        if (inner->count == capacity) {
+            // split a full inner node, the middle key goes up
+            inner_node* right = new inner_node();
+            right->leaf = false;
+            const int mid = capacity / 2;
+            std::move(inner->keys + mid + 1, inner->keys + capacity,
+                      right->keys);
+            std::move(inner->children + mid + 1,
+                      inner->children + capacity + 1, right->children);
+            right->count = capacity - mid - 1;
+            inner->count = mid;
+            sep = inner->keys[mid];
+            split = right;
+
+            if (i > mid) {
+                target = right;
+                i -= mid + 1;
+            }
+        }
+
+        std::move_backward(target->children + i + 1,
+                           target->children + target->count + 1,
+                           target->children + target->count + 2);
+        target->children[i + 1] = csplit;
+        insert_at(target, i, csep);
+        return true;
+    }
+
+    static void destroy(node* n)
+    {
+        if (!n) {
+            return;
+        }
+        if (n->leaf) {
+            delete static_cast<leaf_node*>(n);
+            return;
+        }
+        inner_node* inner = static_cast<inner_node*>(n);
+        for (int i = 0; i <= inner->count; i++) {
+            destroy(inner->children[i]);
+        }
+        delete inner;
+    }
+
+    Comparator comp_;
+    node* root_;
+    size_t size_;
+    int height_;
+};
+
+template <typename T, typename Comparator, size_t NodeBytes>
+const int bplus_tree<T, Comparator, NodeBytes>::capacity;
+
+} // namepace algo
+
+#endif
@@ -11,53 +11,99 @@
 
 #include <iterator> 
 #include <vector>
-#include <algorithm> // std::max()
+#include <memory>    // std::allocator
+#include <cstddef>   // std::ptrdiff_t
+#include <algorithm> // std::max(), std::sort()
+#include <functional> // std::less, std::greater
+#include <type_traits> // std::decay
+#include <utility>   // std::declval, std::pair
+#include <typeinfo>
+#include <limits>    // std::numeric_limits
+#include <cassert>
+#include <stdint.h>  // <cstdint> uint32_t
 
 #include "null_output_iterator.hpp"
+#include "parallel_for.hpp"
 
 namespace algo
 {
 
+    // @brief  Scratch memory for longest_increasing_subsequence.
+    //         Owned by the caller and passed to every call, so that once
+    //         the buffers have grown to the longest sequence seen,
+    //         repeated calls do not allocate at all. The allocator can
+    //         be replaced, e.g. by an arena or a stack buffer allocator.
+    //
+    // @example
+    // lis_workspace<std::ptrdiff_t> ws;
+    // ws.reserve(1000);
+    // for (auto &seq : many_short_sequences) {
+    //     longest_increasing_subsequence(seq.begin(), seq.end(), ws);
+    // }
+
+    template <typename DT = std::ptrdiff_t,
+              typename Allocator = std::allocator<DT> >
+    struct lis_workspace
+    {
+        std::vector<DT, Allocator> tails;
+        std::vector<DT, Allocator> prevs;
+        std::vector<DT, Allocator> lis;
+
+        explicit lis_workspace(const Allocator &alloc = Allocator())
+            : tails(alloc), prevs(alloc), lis(alloc) { }
+
+        // preallocate for sequences of up to n elements
+        void reserve(size_t n)
+        {
+            tails.reserve(n + 1);
+            prevs.reserve(n);
+            lis.reserve(n);
+        }
+    };
+
     // @brief  Compute longest increasing subsequence in the input sequence
+    //         using the caller-owned scratch workspace.
     //
     // @func   longest_increasing_subsequence
     // @time   O(N logN)
-    // @space  O(N)
+    // @space  O(N), no allocations if the workspace is large enough
     //
     // @param [in]  begin - random iterator to the start of the sequence
     // @param [in]  end   - random iterator to the end of the sequence
+    // @param [in]  ws    - scratch workspace, reused between calls
     // @param [out] out   - optional output iterator to write the
     //                      LIS indecies to
     // @param [in]  comp  - opional comparator, by default std::less
     // @return value      - length of longest increasing subsequence
-    //
-    // @example
-    // std::vector<int> seq = { 1, 0, 2, 0, 3 };
-    // std::vector<size_t> lis;
-    // size_t lislen = longest_increasing_subsequence(seq.begin(), seq.end(),
-    //                                                std::back_inserter(lis));
-    
+
     template <typename RandomIterator,
+              typename DT,
+              typename Allocator,
               typename OutputIterator = null_output_iterator,
               typename Comparator =
               std::less< typename std::iterator_traits<RandomIterator>::value_type> >
-    
-    typename std::iterator_traits<RandomIterator>::difference_type
+
+    DT
     longest_increasing_subsequence(RandomIterator begin,
                                    RandomIterator end,
+                                   lis_workspace<DT, Allocator> &ws,
                                    OutputIterator out = OutputIterator(),
                                    Comparator comp = Comparator())
     {
-        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
         const DT undef = (DT)-1;
         const DT seqlen = end - begin;
-        
-        std::vector<DT> tails(seqlen + 1, undef);
-        std::vector<DT> prevs(seqlen, undef);
-        
+
+        // only tails[0..maxlen] are ever read and prevs is fully written,
+        // so the buffers just need the size, not the initialization
+        std::vector<DT, Allocator> &tails = ws.tails;
+        std::vector<DT, Allocator> &prevs = ws.prevs;
+        tails.resize(seqlen + 1);
+        prevs.resize(seqlen);
+        tails[0] = undef;
+
         DT maxlen = 0;
         for (DT i = 0; i < seqlen; ++i) {
-            
+
             // binary search for a tail less than the current element
             DT j = 0, lo = 1, hi = maxlen;
             while (lo <= hi) {
@@ -79,7 +125,8 @@ namespace algo
 
         // backtrack and store the result
         if (typeid(out) != typeid(null_output_iterator)){
-            std::vector<DT> lis(maxlen, 0);
+            std::vector<DT, Allocator> &lis = ws.lis;
+            lis.resize(maxlen);
             DT n = maxlen;
             DT i = tails[maxlen];
             while (i != undef && n > 0) {
@@ -88,13 +135,65 @@ namespace algo
             }
             std::copy(lis.begin(), lis.end(), out);
         }
-        
+
         return maxlen;
     }
 
+    // @brief  Compute longest increasing subsequence in the input sequence
+    //
+    // @func   longest_increasing_subsequence
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin - random iterator to the start of the sequence
+    // @param [in]  end   - random iterator to the end of the sequence
+    // @param [out] out   - optional output iterator to write the
+    //                      LIS indecies to
+    // @param [in]  comp  - opional comparator, by default std::less
+    // @return value      - length of longest increasing subsequence
+    //
+    // @example
+    // std::vector<int> seq = { 1, 0, 2, 0, 3 };
+    // std::vector<size_t> lis;
+    // size_t lislen = longest_increasing_subsequence(seq.begin(), seq.end(),
+    //                                                std::back_inserter(lis));
+    
+    template <typename RandomIterator,
+              typename OutputIterator = null_output_iterator,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+    
+    typename std::iterator_traits<RandomIterator>::difference_type
+    longest_increasing_subsequence(RandomIterator begin,
+                                   RandomIterator end,
+                                   OutputIterator out = OutputIterator(),
+                                   Comparator comp = Comparator())
+    {
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+        lis_workspace<DT> ws;
+        return longest_increasing_subsequence(begin, end, ws, out, comp);
+    }
+
+    // Tile sizes for longest_increasing_subsequence_dp:
+    // lis_dp_block - number of elements i whose LIS lengths are computed
+    //                together against the same tile of predecessors j
+    // lis_dp_l1    - L1 data cache budget for a tile of predecessors
+    //                (values + lengths)
+    const size_t lis_dp_block = 64;
+    const size_t lis_dp_l1    = 16 * 1024;
+
     // @brief  Compute longest increasing subsequence in the input sequence
     //         Dynamic programming approach.
     //
+    //         lislen[i] = 1 + max(lislen[j]) over all j < i with seq[j] < seq[i]
+    //
+    //         The inner max is computed branch-free, so for arithmetic types
+    //         and the default comparator the compiler vectorizes it (compare
+    //         and max over SIMD lanes). The i's are processed in blocks of
+    //         lis_dp_block, and the predecessors j are streamed in tiles that
+    //         fit into L1, so every tile is loaded from memory once per block
+    //         rather than once per element.
+    //
     // @func   longest_increasing_subsequence_dp
     // @time   O(N^2)
     // @space  O(N)
@@ -124,58 +223,673 @@ namespace algo
                                       Comparator comp = Comparator())
     {
         typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
-        const DT undef = (DT)-1;
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
         const DT seqlen = end - begin;
-            
-        // at start, lislen[i] = 1 for all i
-        // meaning longest known increasing subsequence consists of just one
-        // element, the element at index i
-        std::vector<DT> lislen(seqlen, 1);
-        std::vector<DT> prevs(seqlen, undef);
-        DT maxlen = (!!(seqlen)), maxlen_ind = 0;
-
-        // for each index i in the input sequence, starting from the second
-        for (DT i = 1; i < seqlen; ++i) {
-
-            // for each index j, which is before index i in the input sequence
-            for (DT j = 0; j < i; ++j) {
-
-                // check if:
-                // 1. length of longest so far increasing subsequnce ending at j
-                //    is at least as long as longest so far incr. subseq ending at i
-                // 2. element at j is less than element at i, meaning that
-                //    the increasing subsequence ending at i can be extended by
-                //    the increasing subsequence ending at j + element at i
-                if (lislen[j] >= lislen[i] &&
-                    comp(begin[j], begin[i])) {
-                    
-                    lislen[i] = lislen[j] + 1;
-
-                    if (maxlen < lislen[i]) {
-                        maxlen = lislen[i];
-                        maxlen_ind = i;
+
+        // 32-bit lengths keep twice as many lanes per SIMD register
+        // as DT would (LIS length never exceeds the sequence length)
+        assert(seqlen <= (DT)UINT32_MAX);
+        std::vector<uint32_t> lislen(seqlen, 0);
+        std::vector<uint32_t> best(lis_dp_block, 0);
+
+        const DT block = lis_dp_block;
+        const DT tile = std::max<DT>(block, lis_dp_l1 /
+                                     (sizeof(VT) + sizeof(uint32_t)));
+        DT maxlen = 0, maxlen_ind = 0;
+
+        for (DT ib = 0; ib < seqlen; ib += block) {
+            const DT ie = std::min(ib + block, seqlen);
+            std::fill(best.begin(), best.end(), 0);
+
+            // (1) predecessors before the block: independent for every i
+            // in the block, stream them tile by tile
+            for (DT jb = 0; jb < ib; jb += tile) {
+                const DT je = std::min(jb + tile, ib);
+                for (DT i = ib; i < ie; ++i) {
+                    const VT &x = begin[i];
+                    uint32_t m = best[i - ib];
+                    for (DT j = jb; j < je; ++j) {
+                        // unconditional load + mask, no branches
+                        const uint32_t len = lislen[j];
+                        const uint32_t l = len & (0u - (uint32_t)comp(begin[j], x));
+                        m = (l > m) ? l : m;
                     }
+                    best[i - ib] = m;
+                }
+            }
+
+            // (2) predecessors inside the block: lislen[j] is only final
+            // once j itself has been processed, so go one by one
+            for (DT i = ib; i < ie; ++i) {
+                const VT &x = begin[i];
+                uint32_t m = best[i - ib];
+                for (DT j = ib; j < i; ++j) {
+                    const uint32_t len = lislen[j];
+                    const uint32_t l = len & (0u - (uint32_t)comp(begin[j], x));
+                    m = (l > m) ? l : m;
+                }
+                lislen[i] = m + 1;
 
-                    // remember the previous index j to backtrack later
-                    prevs[i] = j;
+                if (maxlen < (DT)lislen[i]) {
+                    maxlen = lislen[i];
+                    maxlen_ind = i;
                 }
             }
         }
 
         // backtrack and store the result
+        // the predecessor of i is any j < i with a smaller element and
+        // lislen[j] = lislen[i] - 1; scanning down from i finds it and
+        // the scans never overlap, so the whole backtracking is O(N)
         if (typeid(out) != typeid(null_output_iterator)){
             std::vector<DT> lis(maxlen, 0);
             DT n = maxlen;
             DT i = maxlen_ind;
-            while (i != undef && n > 0) {
+            if (n > 0) {
                 lis[--n] = i;
-                i = prevs[i];
+            }
+            for (DT j = i - 1; j >= 0 && n > 0; --j) {
+                if (lislen[j] + 1 == lislen[i] && comp(begin[j], begin[i])) {
+                    lis[--n] = i = j;
+                }
             }
             std::copy(lis.begin(), lis.end(), out);
         }
 
         return maxlen;
     }
+
+    // @brief  Coordinate compression: maps every element of the sequence
+    //         to its rank 1..K in the order given by comp.
+    //         Equivalent elements share the same rank.
+    //
+    // @func   lis_compress_ranks
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin - random iterator to the start of the sequence
+    // @param [in]  end   - random iterator to the end of the sequence
+    // @param [out] rank  - rank of every element
+    // @param [in]  comp  - comparator
+    // @return value      - number of distinct ranks K
+
+    template <typename RandomIterator, typename Comparator>
+
+    typename std::iterator_traits<RandomIterator>::difference_type
+    lis_compress_ranks(RandomIterator begin,
+                       RandomIterator end,
+                       std::vector<typename std::iterator_traits<
+                           RandomIterator>::difference_type> &rank,
+                       Comparator comp)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        const DT seqlen = end - begin;
+
+        // sort copies of the values, not indices, to keep the sort
+        // cache friendly
+        std::vector<std::pair<VT, DT> > order(seqlen);
+        for (DT i = 0; i < seqlen; ++i) {
+            order[i] = std::make_pair(begin[i], i);
+        }
+        std::sort(order.begin(), order.end(),
+                  [ & ] (const std::pair<VT, DT> &a, const std::pair<VT, DT> &b)
+                  { return comp(a.first, b.first); });
+
+        rank.resize(seqlen);
+        DT nranks = 0;
+        for (DT k = 0; k < seqlen; ++k) {
+            if (k == 0 || comp(order[k-1].first, order[k].first)) {
+                ++nranks;
+            }
+            rank[order[k].second] = nranks;
+        }
+        return nranks;
+    }
+
+    // Random access stub yielding the same weight for every index.
+    // Turns the weighted engine below into a plain (unit weight) LIS.
+    template <typename T>
+    struct lis_unit_weights
+    {
+        T operator[](size_t) const { return 1; }
+    };
+
+    // @brief  Compute maximum-weight increasing subsequence
+    //         Fenwick tree (binary indexed tree) approach.
+    //
+    //         The values are coordinate-compressed to ranks 1..K in the
+    //         order given by comp (equivalent values share a rank). Then for
+    //         every element i the Fenwick tree answers "max weight of an
+    //         increasing subsequence ending with a rank below rank(i)"
+    //         (or "not above" rank(i) when strict is false), the element is
+    //         appended and the tree is updated at rank(i).
+    //
+    //         With strict = false the result is a non-decreasing subsequence.
+    //         Subsequences of negative total weight are never extended,
+    //         and for an empty sequence the result is 0.
+    //
+    // @func   longest_increasing_subsequence_weighted
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin   - random iterator to the start of the sequence
+    // @param [in]  end     - random iterator to the end of the sequence
+    // @param [in]  weights - random iterator to the weights of the elements
+    //                        (weights[i] is the weight of begin[i])
+    // @param [out] out     - optional output iterator to write the
+    //                        LIS indecies to
+    // @param [in]  comp    - opional comparator, by default std::less
+    // @param [in]  strict  - opional, false to allow equal neighbours
+    // @return value        - total weight of the subsequence
+    //
+    // @example
+    // std::vector<int> seq = { 1, 0, 2, 0, 3 };
+    // std::vector<int> wgt = { 1, 5, 1, 5, 1 };
+    // std::vector<size_t> lis;
+    // int w = longest_increasing_subsequence_weighted(seq.begin(), seq.end(),
+    //                                                 wgt.begin(),
+    //                                                 std::back_inserter(lis));
+    // // w = 6, lis = { 1, 4 }
+
+    template <typename RandomIterator,
+              typename WeightIterator,
+              typename OutputIterator = null_output_iterator,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+
+    typename std::decay<decltype(std::declval<WeightIterator>()[0])>::type
+    longest_increasing_subsequence_weighted(RandomIterator begin,
+                                            RandomIterator end,
+                                            WeightIterator weights,
+                                            OutputIterator out = OutputIterator(),
+                                            Comparator comp = Comparator(),
+                                            bool strict = true)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+        typedef typename std::decay<decltype(weights[0])>::type WT;
+        const DT undef = (DT)-1;
+        const DT seqlen = end - begin;
+
+        // coordinate compression: rank[i] in 1..nranks
+        std::vector<DT> rank;
+        const DT nranks = lis_compress_ranks(begin, end, rank, comp);
+
+        // Fenwick tree for prefix max: the node r covers ranks
+        // (r - lowbit(r), r] and keeps the best weight and its end index
+        // (kept together, one cache miss per node)
+        struct fenwick_node { WT w; DT i; };
+        std::vector<fenwick_node> fw(nranks + 1, fenwick_node{ WT(), undef });
+        std::vector<DT> prevs(seqlen, undef);
+
+        WT maxw = WT();
+        DT maxw_ind = undef;
+        for (DT i = 0; i < seqlen; ++i) {
+
+            // query max over ranks [1, r]
+            WT w = WT();
+            DT p = undef;
+            for (DT r = rank[i] - (strict ? 1 : 0); r > 0; r -= r & -r) {
+                if (w < fw[r].w) {
+                    w = fw[r].w;
+                    p = fw[r].i;
+                }
+            }
+
+            prevs[i] = p;
+            w += weights[i];
+            if (maxw_ind == undef || maxw < w) {
+                maxw = w;
+                maxw_ind = i;
+            }
+
+            // update ranks [rank[i], nranks]
+            for (DT r = rank[i]; r <= nranks; r += r & -r) {
+                if (fw[r].w < w || fw[r].i == undef) {
+                    fw[r].w = w;
+                    fw[r].i = i;
+                }
+            }
+        }
+
+        // backtrack and store the result
+        if (typeid(out) != typeid(null_output_iterator)){
+            std::vector<DT> lis;
+            for (DT i = maxw_ind; i != undef; i = prevs[i]) {
+                lis.push_back(i);
+            }
+            std::copy(lis.rbegin(), lis.rend(), out);
+        }
+
+        return maxw;
+    }
+
+    // @brief  Compute longest non-decreasing subsequence in the input sequence
+    //         (equal neighbours allowed). Fenwick tree engine with unit weights.
+    //
+    // @func   longest_non_decreasing_subsequence
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin - random iterator to the start of the sequence
+    // @param [in]  end   - random iterator to the end of the sequence
+    // @param [out] out   - optional output iterator to write the
+    //                      subsequence indecies to
+    // @param [in]  comp  - opional comparator, by default std::less
+    // @return value      - length of longest non-decreasing subsequence
+
+    template <typename RandomIterator,
+              typename OutputIterator = null_output_iterator,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+
+    typename std::iterator_traits<RandomIterator>::difference_type
+    longest_non_decreasing_subsequence(RandomIterator begin,
+                                       RandomIterator end,
+                                       OutputIterator out = OutputIterator(),
+                                       Comparator comp = Comparator())
+    {
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+        return longest_increasing_subsequence_weighted(begin, end,
+                                                       lis_unit_weights<DT>(),
+                                                       out, comp, false);
+    }
+
+    // @brief  Compute longest strictly decreasing subsequence in the input
+    //         sequence. Same as longest_increasing_subsequence with the
+    //         reversed comparator.
+    //
+    // @func   longest_decreasing_subsequence
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin - random iterator to the start of the sequence
+    // @param [in]  end   - random iterator to the end of the sequence
+    // @param [out] out   - optional output iterator to write the
+    //                      subsequence indecies to
+    // @return value      - length of longest decreasing subsequence
+
+    template <typename RandomIterator,
+              typename OutputIterator = null_output_iterator>
+
+    typename std::iterator_traits<RandomIterator>::difference_type
+    longest_decreasing_subsequence(RandomIterator begin,
+                                   RandomIterator end,
+                                   OutputIterator out = OutputIterator())
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        return longest_increasing_subsequence(begin, end, out,
+                                              std::greater<VT>());
+    }
+
+    // Number of sequences processed in lockstep (SIMD lanes) by
+    // longest_increasing_subsequence_batch
+    const size_t lis_batch_lanes = 8;
+
+    // @brief  Compute LIS lengths of many independent sequences of equal
+    //         length stored as rows of a row-major 2D block.
+    //
+    //         lis_batch_lanes rows are processed in lockstep. Their tails
+    //         are interleaved (tails[k * lanes + lane], unused slots hold
+    //         the max value, +inf for floating point), so that for every column the position of the
+    //         new element in each lane is found by counting the tails less
+    //         than it, and the tails are updated with a select. Both loops
+    //         run over all lanes at once and vectorize for arithmetic types.
+    //         The counting is O(LIS length) per element instead of the
+    //         O(log LIS length) binary search, which pays off for short
+    //         rows, where the binary search branches are unpredictable.
+    //
+    //         The rows are split between nthreads threads (see
+    //         parallel_for_ranges, exceptions reach the caller).
+    //         Only the default ordering (std::less) of arithmetic types is
+    //         supported.
+    //
+    // @func   longest_increasing_subsequence_batch
+    // @time   O(rows * cols * LIS length / lanes / nthreads)
+    // @space  O(cols * lanes * nthreads)
+    //
+    // @param [in]  block    - random iterator to the start of the 2D block
+    // @param [in]  rows     - number of sequences (rows)
+    // @param [in]  cols     - length of every sequence (columns)
+    // @param [out] lens     - random iterator, lens[r] = LIS length of row r
+    // @param [in]  nthreads - opional number of threads, by default 1
+    // @return value         - void
+    //
+    // @example
+    // std::vector<int> block = { 1, 0, 2,
+    //                            3, 2, 1 };
+    // std::vector<size_t> lens(2);
+    // longest_increasing_subsequence_batch(block.begin(), 2, 3, lens.begin());
+    // // lens = { 2, 1 }
+
+    template <typename RandomIterator,
+              typename RandomOutputIterator,
+              typename DT =
+              typename std::iterator_traits<RandomIterator>::difference_type>
+
+    void
+    longest_increasing_subsequence_batch(RandomIterator block,
+                                         DT rows, DT cols,
+                                         RandomOutputIterator lens,
+                                         unsigned nthreads = 1)
+    {
+        typedef typename std::iterator_traits<RandomIterator>::value_type VT;
+        static_assert(std::is_arithmetic<VT>::value,
+                      "batch LIS needs an arithmetic value type");
+        const DT lanes = lis_batch_lanes;
+        // the unused tails must not be less than any element, +inf included
+        const VT vtmax = std::numeric_limits<VT>::has_infinity ?
+            std::numeric_limits<VT>::infinity() :
+            std::numeric_limits<VT>::max();
+
+        auto run = [ = ] (DT rbegin, DT rend) {
+            std::vector<VT> tails(cols * lanes);
+            VT x[lis_batch_lanes];
+            uint32_t p[lis_batch_lanes], len[lis_batch_lanes];
+
+            for (DT r0 = rbegin; r0 < rend; r0 += lanes) {
+                const DT nl = std::min(lanes, rend - r0);
+                std::fill(tails.begin(), tails.end(), vtmax);
+                std::fill(len, len + lanes, 0);
+                DT maxlen = 0;
+
+                for (DT i = 0; i < cols; ++i) {
+                    // missing rows in the last group get the max value,
+                    // their results are not used
+                    for (DT lane = 0; lane < lanes; ++lane) {
+                        x[lane] = (lane < nl) ? block[(r0 + lane) * cols + i]
+                                              : vtmax;
+                        p[lane] = 0;
+                    }
+
+                    // position = number of tails less than x
+                    for (DT k = 0; k < maxlen; ++k) {
+                        const VT *t = &tails[k * lanes];
+                        for (DT lane = 0; lane < lanes; ++lane) {
+                            p[lane] += (uint32_t)(t[lane] < x[lane]);
+                        }
+                    }
+
+                    // tails[p] = x
+                    const uint32_t kend = std::min(maxlen + 1, cols);
+                    for (uint32_t k = 0; k < kend; ++k) {
+                        VT *t = &tails[k * lanes];
+                        for (DT lane = 0; lane < lanes; ++lane) {
+                            t[lane] = (p[lane] == k) ? x[lane] : t[lane];
+                        }
+                    }
+
+                    for (DT lane = 0; lane < lanes; ++lane) {
+                        len[lane] = std::max(len[lane], p[lane] + 1);
+                        maxlen = std::max(maxlen, (DT)len[lane]);
+                    }
+                }
+
+                for (DT lane = 0; lane < nl; ++lane) {
+                    lens[r0 + lane] = len[lane];
+                }
+            }
+        };
+
+        parallel_for_ranges(rows, lanes, nthreads, run);
+    }
+
+    // @brief  Compute LIS of many independent sequences of equal length
+    //         stored as rows of a row-major 2D block, with the indecies.
+    //         The rows are split between nthreads threads, every thread
+    //         reuses one lis_workspace for all its rows.
+    //
+    // @func   longest_increasing_subsequence_batch_lis
+    // @time   O(rows * cols logN / nthreads)
+    // @space  O(cols * nthreads)
+    //
+    // @param [in]  block    - random iterator to the start of the 2D block
+    // @param [in]  rows     - number of sequences (rows)
+    // @param [in]  cols     - length of every sequence (columns)
+    // @param [out] lens     - random iterator, lens[r] = LIS length of row r
+    // @param [out] lises    - random iterator to a rows x cols block, the
+    //                         first lens[r] elements of row r are set to
+    //                         the LIS indecies (within the row)
+    // @param [in]  nthreads - opional number of threads, by default 1
+    // @param [in]  comp     - opional comparator, by default std::less
+    // @return value         - void
+
+    template <typename RandomIterator,
+              typename RandomOutputIterator1,
+              typename RandomOutputIterator2,
+              typename DT =
+              typename std::iterator_traits<RandomIterator>::difference_type,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+
+    void
+    longest_increasing_subsequence_batch_lis(RandomIterator block,
+                                             DT rows, DT cols,
+                                             RandomOutputIterator1 lens,
+                                             RandomOutputIterator2 lises,
+                                             unsigned nthreads = 1,
+                                             Comparator comp = Comparator())
+    {
+        auto run = [ = ] (DT rbegin, DT rend) {
+            lis_workspace<DT> ws;
+            ws.reserve(cols);
+            for (DT r = rbegin; r < rend; ++r) {
+                lens[r] = longest_increasing_subsequence(
+                    block + r * cols, block + (r + 1) * cols, ws,
+                    lises + r * cols, comp);
+            }
+        };
+
+        parallel_for_ranges(rows, (DT)1, nthreads, run);
+    }
+
+    // @brief  Count longest increasing subsequences in the input sequence.
+    //         Two subsequences are different if they differ in at least
+    //         one index. Fenwick tree approach.
+    //
+    //         Every Fenwick node keeps the longest length found over its
+    //         ranks together with the number of subsequences of that
+    //         length. Both are combined with "max length, sum counts of
+    //         equal lengths". The count is taken modulo 2^64 by default,
+    //         or modulo a given number (e.g. a prime).
+    //
+    // @func   longest_increasing_subsequence_count
+    // @time   O(N logN)
+    // @space  O(N)
+    //
+    // @param [in]  begin  - random iterator to the start of the sequence
+    // @param [in]  end    - random iterator to the end of the sequence
+    // @param [in]  modulo - opional modulo of the count, 0 means 2^64
+    // @param [in]  comp   - opional comparator, by default std::less
+    // @return value       - number of longest increasing subsequences
+    //
+    // @example
+    // std::vector<int> seq = { 1, 3, 2, 4 };
+    // uint64_t n = longest_increasing_subsequence_count(seq.begin(),
+    //                                                   seq.end());
+    // // n = 2: { 0, 1, 3 } and { 0, 2, 3 }
+
+    template <typename RandomIterator,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+
+    uint64_t
+    longest_increasing_subsequence_count(RandomIterator begin,
+                                         RandomIterator end,
+                                         uint64_t modulo = 0,
+                                         Comparator comp = Comparator())
+    {
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+        const DT seqlen = end - begin;
+
+        // a + b (mod modulo), for modulo = 0 the natural 2^64 wrap around
+        auto add = [ modulo ] (uint64_t a, uint64_t b) -> uint64_t {
+            return (modulo == 0 || a < modulo - b) ? a + b : a - (modulo - b);
+        };
+
+        std::vector<DT> rank;
+        const DT nranks = lis_compress_ranks(begin, end, rank, comp);
+
+        struct fenwick_node { DT len; uint64_t cnt; };
+        std::vector<fenwick_node> fw(nranks + 1, fenwick_node{ 0, 0 });
+        fenwick_node total = { 0, 0 };
+
+        // one subsequence, reduced as well (0 for modulo = 1)
+        const uint64_t one = (modulo == 0) ? 1 : 1 % modulo;
+
+        for (DT i = 0; i < seqlen; ++i) {
+
+            // query over ranks [1, rank[i] - 1]
+            // (nothing found => the element alone, one subsequence)
+            fenwick_node q = { 0, one };
+            for (DT r = rank[i] - 1; r > 0; r -= r & -r) {
+                if (q.len < fw[r].len) {
+                    q = fw[r];
+                } else if (q.len == fw[r].len && q.len > 0) {
+                    q.cnt = add(q.cnt, fw[r].cnt);
+                }
+            }
+            q.len += 1;
+
+            if (total.len < q.len) {
+                total = q;
+            } else if (total.len == q.len) {
+                total.cnt = add(total.cnt, q.cnt);
+            }
+
+            // update ranks [rank[i], nranks]
+            for (DT r = rank[i]; r <= nranks; r += r & -r) {
+                if (fw[r].len < q.len) {
+                    fw[r] = q;
+                } else if (fw[r].len == q.len) {
+                    fw[r].cnt = add(fw[r].cnt, q.cnt);
+                }
+            }
+        }
+
+        return total.cnt;
+    }
+
+    // @brief  Lazy enumeration of all longest increasing subsequences.
+    //         Generator style: every call to next() produces the next
+    //         LIS (indecies in increasing order) until it returns false.
+    //
+    //         The elements are grouped into levels by the length of the
+    //         LIS ending at them. Within a level the indecies increase
+    //         while the values do not increase, so the possible
+    //         predecessors of an element form one contiguous range of the
+    //         previous level. The enumeration is a DFS over those ranges
+    //         and keeps only one cursor per level: no subsequence other
+    //         than the current one is ever stored.
+    //
+    // @class  lis_enumerator
+    // @time   O(N logN) setup, O(L logN) per subsequence
+    // @space  O(N)
+    //
+    // @example
+    // std::vector<int> seq = { 1, 3, 2, 4 };
+    // lis_enumerator<std::vector<int>::iterator> lisenum(seq.begin(), seq.end());
+    // while (lisenum.next()) {
+    //     // lisenum.lis() = { 0, 1, 3 }, then { 0, 2, 3 }
+    // }
+
+    template <typename RandomIterator,
+              typename Comparator =
+              std::less< typename std::iterator_traits<RandomIterator>::value_type> >
+    class lis_enumerator
+    {
+    public:
+        typedef typename std::iterator_traits<RandomIterator>::difference_type DT;
+
+        lis_enumerator(RandomIterator begin, RandomIterator end,
+                       Comparator comp = Comparator())
+            : begin_(begin), comp_(comp), started_(false)
+        {
+            const DT seqlen = end - begin;
+
+            // patience sorting: level of i = length of the LIS ending at i
+            std::vector<DT> tails;
+            for (DT i = 0; i < seqlen; ++i) {
+                auto it = std::lower_bound(tails.begin(), tails.end(), i,
+                                           [ & ] (DT t, DT x)
+                                           { return comp_(begin_[t], begin_[x]); });
+                DT lvl = it - tails.begin();
+                if (it == tails.end()) {
+                    tails.push_back(i);
+                    levels_.push_back(std::vector<DT>());
+                } else {
+                    *it = i;
+                }
+                levels_[lvl].push_back(i);
+            }
+
+            lis_.resize(levels_.size());
+            pos_.resize(levels_.size());
+            hi_.resize(levels_.size());
+        }
+
+        // @return value - length of the longest increasing subsequences
+        DT length() const { return levels_.size(); }
+
+        // @return value - the current subsequence (valid after next())
+        const std::vector<DT> &lis() const { return lis_; }
+
+        // @brief  Advance to the next longest increasing subsequence
+        // @return value - false if there are no more subsequences
+        bool next()
+        {
+            const DT len = levels_.size();
+            if (len == 0) {
+                return false;
+            }
+
+            DT k;
+            if (!started_) {
+                // first call: the whole last level is the range
+                started_ = true;
+                k = len - 1;
+                pos_[k] = 0;
+                hi_[k] = levels_[k].size();
+            } else {
+                // backtrack: find the deepest level with more candidates
+                k = 0;
+                while (k < len && pos_[k] + 1 >= hi_[k]) {
+                    ++k;
+                }
+                if (k == len) {
+                    return false;
+                }
+                ++pos_[k];
+            }
+
+            // descend: every candidate has at least one predecessor
+            lis_[k] = levels_[k][pos_[k]];
+            for (; k > 0; --k) {
+                const std::vector<DT> &prev = levels_[k-1];
+                const DT i = lis_[k];
+                // predecessors have index < i ...
+                auto hi = std::lower_bound(prev.begin(), prev.end(), i);
+                // ... and value < begin_[i] (a suffix, values don't increase)
+                auto lo = std::partition_point(prev.begin(), hi,
+                                               [ & ] (DT j)
+                                               { return !comp_(begin_[j], begin_[i]); });
+                pos_[k-1] = lo - prev.begin();
+                hi_[k-1] = hi - prev.begin();
+                lis_[k-1] = *lo;
+            }
+
+            return true;
+        }
+
+    private:
+        RandomIterator begin_;
+        Comparator comp_;
+        bool started_;
+        std::vector<std::vector<DT> > levels_;
+        std::vector<DT> lis_;   // current subsequence, lis_[k] at level k
+        std::vector<DT> pos_;   // cursor in levels_[k]
+        std::vector<DT> hi_;    // end of the candidate range in levels_[k]
+    };
 }
 
 #endif
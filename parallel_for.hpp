@@ -0,0 +1,79 @@
+/// ****************************************************************************
+///
+/// @file   : parallel_for.hpp
+/// @brief  : Static split of an index range between threads
+///
+/// @author : Alexander Korobeynikov (alexander.korobeynikov@gmail.com)
+///
+/// ****************************************************************************
+#ifndef ALGO_PARALLEL_FOR_HPP
+#define ALGO_PARALLEL_FOR_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <exception>   // std::exception_ptr
+#include <algorithm>   // std::max(), std::min()
+
+namespace algo
+{
+
+/// ----------------------------------------------------------------------------
+/// @brief Splits [0, count) into at most nthreads contiguous ranges, whose
+///        lengths are multiples of align (but the last one), and runs
+///        func(begin, end) for every range, the first one in the calling
+///        thread. All the started threads are joined on every path: if a
+///        thread can't be started or func throws, the first exception is
+///        rethrown on the calling thread once the others have finished.
+///
+/// @param[in]  count     number of indices
+/// @param[in]  align     granularity of the ranges
+/// @param[in]  nthreads  number of threads
+/// @param[in]  func      range callback
+/// @return               void
+template <typename DT, typename Func>
+void
+parallel_for_ranges(DT count, DT align, unsigned nthreads, Func func)
+{
+    nthreads = std::max(1u, nthreads);
+    align = std::max<DT>(1, align);
+    DT step = (count + nthreads - 1) / nthreads;
+    step = std::max<DT>(align, (step + align - 1) / align * align);
+
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto run = [ & ] (DT begin, DT end) {
+        try {
+            func(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(error_mutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    try {
+        threads.reserve(nthreads - 1);
+        for (DT r = step; r < count; r += step) {
+            threads.emplace_back(run, r, std::min<DT>(r + step, count));
+        }
+    } catch (...) {
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        throw;
+    }
+    run(0, std::min(step, count));
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namepace algo
+
+#endif
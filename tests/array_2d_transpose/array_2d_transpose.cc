@@ -4,16 +4,28 @@
 #include <iostream>  // std::cin, std::cout
 #include <stdlib.h>  // rand()
 #include <time.h>    // time()
+#include <chrono>
+#include <functional>
+#include <string>
+#include <stdio.h>   // tmpfile(), fileno()
+#include <fcntl.h>   // open()
+#include <unistd.h>  // close(), unlink()
+#include <sys/resource.h> // getrusage()
+#include <memory>    // std::unique_ptr
 
 #include <boost/program_options.hpp>
 #include <boost/format.hpp>
 
 #include "algo/array_2d_transpose.hpp"
+#include "algo/array_2d_transpose_file.hpp"
 
 namespace po = boost::program_options;
 
 using array = std::vector<int>;
 
+// number of threads for the parallel transposes
+unsigned nthreads = 4;
+
 void print_array_1d(const array &arr, size_t n)
 {
     for (size_t i = 0; i < n; i++) {
@@ -32,11 +44,413 @@ void print_array_2d(const array &arr, size_t n, size_t m)
     }
 }
 
+// transpose of the n x m array arr into the m x n array out
+// (out-of-place algorithms write to out, in-place ones to arr and
+// copy it to out)
+using transpose_func =
+    std::function<void(array &arr, array &out, size_t n, size_t m)>;
+
+struct transpose_algo
+{
+    const char *name;
+    transpose_func func;
+    bool square_only;
+};
+
+std::vector<transpose_algo> transpose_algos()
+{
+    return {
+        { "inplace", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose(arr.begin(), n, m);
+                out.swap(arr); } },
+        { "inplace_v1", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_v1(arr.begin(), n, m);
+                out.swap(arr); } },
+        { "inplace_v2", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_v2(arr.begin(), n, m);
+                out.swap(arr); } },
+        { "inplace_v3", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_v3(arr.begin(), n, m);
+                out.swap(arr); } },
+        { "inplace_parallel", [ ] (array &arr, array &out,
+                                   size_t n, size_t m) {
+                algo::array_2d_transpose_parallel(arr.begin(), n, m,
+                                                  nthreads);
+                out.swap(arr); } },
+        { "blocked", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_blocked(arr.begin(), out.begin(),
+                                                 n, m); } },
+        { "recursive", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_recursive(arr.begin(), out.begin(),
+                                                   n, m); } },
+        { "simd", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_simd(arr.data(), out.data(),
+                                              n, m); } },
+        { "square", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_square(arr.begin(), n);
+                out.swap(arr); }, true },
+        { "square_simd", [ ] (array &arr, array &out, size_t n, size_t m) {
+                algo::array_2d_transpose_square_simd(arr.data(), n);
+                out.swap(arr); }, true },
+    };
+}
+
+bool check_transpose(const transpose_algo &ta, size_t n, size_t m)
+{
+    if (ta.square_only && n != m) {
+        return true;
+    }
+
+    array arr1(n * m);
+    for (size_t i = 0; i < arr1.size(); i++) {
+        arr1[i] = i;
+    }
+
+    array arr2 = arr1;
+    array out(n * m, -1);
+    ta.func(arr2, out, n, m);
+
+    bool bOk = true;
+    for (size_t i = 0; (i < n) && bOk; i++) {
+        for (size_t j = 0; (j < m) && bOk; j++) {
+            if (arr1[m*i+j] != out[n*j+i]) {
+                bOk = false;
+                std::cout <<
+                    boost::format("%s: n = %d, m = %d, i = %d, j = %d\n"
+                                  "arr1[m*i+j = %d] = %d\n"
+                                  "out[n*j+i = %d] = %d\n")
+                    % ta.name % n % m % i % j
+                    % (m*i+j) % (arr1[m*i+j])
+                    % (n*j+i) % (out[n*j+i]);
+            }
+        }
+    }
+
+    if (!bOk) {
+        std::cout << "\narr1 (original)  : ";
+        print_array_1d(arr1, n*m);
+        print_array_2d(arr1, n, m);
+        std::cout << "\nout (transposed): ";
+        print_array_1d(out, n*m);
+        print_array_2d(out, m, n);
+    }
+    return bOk;
+}
+
+// SIMD kernels for 8-byte elements
+bool check_transpose_simd_double(size_t n, size_t m)
+{
+    std::vector<double> arr(n * m), out(n * m);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i + 0.5;
+    }
+
+    algo::array_2d_transpose_simd(arr.data(), out.data(), n, m);
+    std::vector<double> sq = arr;
+    if (n == m) {
+        algo::array_2d_transpose_square_simd(sq.data(), n);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < m; j++) {
+            if (arr[m*i+j] != out[n*j+i] ||
+                (n == m && arr[m*i+j] != sq[n*j+i])) {
+                std::cout << boost::format("simd (double): n = %d, m = %d, "
+                                           "i = %d, j = %d\n") % n % m % i % j;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// batch of count n x m arrays back to back
+bool check_transpose_batch(size_t n, size_t m, size_t count)
+{
+    array arr(n * m * count);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i;
+    }
+
+    array out = arr;
+    algo::array_2d_transpose_batch(out.begin(), n, m, count, nthreads);
+
+    for (size_t k = 0; k < count; k++) {
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < m; j++) {
+                if (arr[k*n*m + m*i+j] != out[k*n*m + n*j+i]) {
+                    std::cout << boost::format("batch: n = %d, m = %d, "
+                                               "k = %d, i = %d, j = %d\n")
+                        % n % m % k % i % j;
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// move-only elements (the in-place transpose without scratch space)
+bool check_transpose_move_only(size_t n, size_t m)
+{
+    std::vector<std::unique_ptr<size_t>> arr(n * m);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i].reset(new size_t(i));
+    }
+
+    algo::array_2d_transpose(arr.begin(), n, m);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < m; j++) {
+            if (*arr[n*j+i] != m*i+j) {
+                std::cout << boost::format("move-only: n = %d, m = %d, "
+                                           "i = %d, j = %d\n")
+                    % n % m % i % j;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// n x m sub-matrix at (r0, c0) of a larger rows x cols array
+bool check_transpose_strided(size_t n, size_t m)
+{
+    const size_t rows = n + 3, cols = m + 5, r0 = 2, c0 = 3;
+    const size_t ldd = n + 7;
+    std::vector<double> arr(rows * cols), dsimd(m * ldd, -1);
+    array iarr(rows * cols), dblk(m * ldd, -1);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i;
+        iarr[i] = i;
+    }
+
+    algo::array_2d_transpose_blocked(iarr.begin() + r0 * cols + c0, cols,
+                                     dblk.begin(), ldd, n, m);
+    algo::array_2d_transpose_simd(arr.data() + r0 * cols + c0, cols,
+                                  dsimd.data(), ldd, n, m);
+    array sq = iarr;
+    const size_t nsq = std::min(n, m);
+    algo::array_2d_transpose_square(sq.begin() + r0 * cols + c0, nsq, cols);
+    std::vector<double> sqd = arr;
+    algo::array_2d_transpose_square_simd(sqd.data() + r0 * cols + c0,
+                                         nsq, cols);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < m; j++) {
+            const size_t s = (r0 + i) * cols + c0 + j;
+            if (dblk[j * ldd + i] != iarr[s] || dsimd[j * ldd + i] != arr[s]) {
+                std::cout << boost::format("strided: n = %d, m = %d, "
+                                           "i = %d, j = %d\n") % n % m % i % j;
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            const bool inside = (i >= r0 && i < r0 + nsq &&
+                                 j >= c0 && j < c0 + nsq);
+            const size_t t = inside ?
+                (r0 + j - c0) * cols + c0 + i - r0 : i * cols + j;
+            if (sq[i * cols + j] != iarr[t] || sqd[i * cols + j] != arr[t]) {
+                std::cout << boost::format("strided square: n = %d, "
+                                           "i = %d, j = %d\n") % nsq % i % j;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// out-of-core transpose through temporary files, with a budget small
+// enough to force tiles that span neither whole rows nor whole columns
+bool check_transpose_file(size_t n, size_t m, size_t budget)
+{
+    array arr(n * m), out(n * m, -1);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i;
+    }
+
+    FILE *fsrc = tmpfile(), *fdst = tmpfile();
+    const size_t bytes = arr.size() * sizeof(array::value_type);
+    bool bOk = fsrc && fdst &&
+        algo::array_2d_pwrite(fileno(fsrc), arr.data(), bytes, 0) &&
+        algo::array_2d_transpose_file<int>(fileno(fsrc), fileno(fdst),
+                                           n, m, budget) &&
+        algo::array_2d_pread(fileno(fdst), out.data(), bytes, 0);
+
+    for (size_t i = 0; (i < n) && bOk; i++) {
+        for (size_t j = 0; (j < m) && bOk; j++) {
+            bOk = (arr[m*i+j] == out[n*j+i]);
+        }
+    }
+    if (!bOk) {
+        std::cout << boost::format("file: n = %d, m = %d, budget = %d\n")
+            % n % m % budget;
+    }
+    if (fsrc) fclose(fsrc);
+    if (fdst) fclose(fdst);
+    return bOk;
+}
+
+// array_2d_mulmod against the plain (a * x) % d, also for the moduli
+// where a * x overflows 64 bits
+bool check_mulmod()
+{
+    const uint64_t mods[] = { 2, 3, 7, 64, 1000003, 4294967311ULL,
+                              (1ULL << 40) + 15, (1ULL << 63) - 25 };
+    for (uint64_t d : mods) {
+        for (int t = 0; t < 1000; t++) {
+            uint64_t a = (((uint64_t)rand() << 32) ^ rand()) % d;
+            uint64_t x = (((uint64_t)rand() << 32) ^ rand()) % d;
+            if (t < 3) {
+                x = d - 1 - t % d;
+            }
+            uint64_t r = (uint64_t)(((unsigned __int128)a * x) % d);
+            if (algo::array_2d_mulmod(a, d)(x) != r) {
+                std::cout << boost::format("mulmod: a = %d, x = %d, d = %d\n")
+                    % a % x % d;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// transposes a rows x cols array and prints the throughput:
+// every element is read once and written once (one swap for the
+// cycle-following algorithms)
+void bench_transpose(const transpose_algo &ta, size_t rows, size_t cols,
+                     int repeat)
+{
+    array arr(rows * cols), out(rows * cols);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i;
+    }
+
+    double best = 0;
+    size_t n = rows, m = cols;
+    for (int r = 0; r < repeat; r++) {
+        auto t0 = std::chrono::steady_clock::now();
+        ta.func(arr, out, n, m);
+        std::chrono::duration<double> sec =
+            std::chrono::steady_clock::now() - t0;
+        if (r == 0 || sec.count() < best) {
+            best = sec.count();
+        }
+        // transpose it back on the next run
+        std::swap(n, m);
+        arr.swap(out);
+    }
+
+    double gb = 2.0 * arr.size() * sizeof(array::value_type) / 1e9;
+    std::cout << boost::format("%-16s %6d x %-6d %8.4f sec %8.2f GB/s "
+                               "%8.1f M elem/s\n")
+        % ta.name % rows % cols % best % (gb / best)
+        % (arr.size() / best / 1e6);
+}
+
+// transposes count rows x cols arrays stored back to back, one call per
+// array vs. array_2d_transpose_batch()
+void bench_transpose_batch(size_t rows, size_t cols, size_t count)
+{
+    array arr(rows * cols * count);
+    for (size_t i = 0; i < arr.size(); i++) {
+        arr[i] = i;
+    }
+
+    auto run = [ & ] (const char *name, std::function<void()> func) {
+        auto t0 = std::chrono::steady_clock::now();
+        func();
+        std::chrono::duration<double> sec =
+            std::chrono::steady_clock::now() - t0;
+        std::cout << boost::format("%-16s %d x %d x %-8d %8.4f sec "
+                                   "%8.1f M matrices/s\n")
+            % name % rows % cols % count % sec.count()
+            % (count / sec.count() / 1e6);
+    };
+
+    const size_t nm = rows * cols;
+    run("inplace", [ & ] {
+            for (size_t k = 0; k < count; k++) {
+                algo::array_2d_transpose(arr.begin() + k * nm, rows, cols);
+            } });
+    run("inplace_v2", [ & ] {
+            for (size_t k = 0; k < count; k++) {
+                algo::array_2d_transpose_v2(arr.begin() + k * nm, cols, rows);
+            } });
+    run("batch", [ & ] {
+            algo::array_2d_transpose_batch(arr.begin(), rows, cols, count,
+                                           nthreads); });
+}
+
+// out-of-core transpose of a rows x cols array of 32-bit values in file
+// path (written first, a row at a time) into path.T within budget bytes,
+// then reads it back a row at a time to verify; both files are removed
+int bench_transpose_file(const std::string &path, size_t rows, size_t cols,
+                         size_t budget)
+{
+    const std::string tpath = path + ".T";
+    int src = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int dst = open(tpath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (src < 0 || dst < 0) {
+        perror("open");
+        return 2;
+    }
+
+    std::vector<uint32_t> row(std::max(rows, cols));
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            row[j] = (uint32_t)(i * cols + j);
+        }
+        algo::array_2d_pwrite(src, row.data(), cols * sizeof(uint32_t),
+                              (off_t)(i * cols * sizeof(uint32_t)));
+    }
+    fsync(src);
+
+    auto t0 = std::chrono::steady_clock::now();
+    bool bOk = algo::array_2d_transpose_file<uint32_t>(src, dst, rows, cols,
+                                                       budget);
+    fsync(dst);
+    std::chrono::duration<double> sec = std::chrono::steady_clock::now() - t0;
+    if (!bOk) {
+        perror("array_2d_transpose_file");
+    }
+
+    for (size_t j = 0; (j < cols) && bOk; j++) {
+        bOk = algo::array_2d_pread(dst, row.data(), rows * sizeof(uint32_t),
+                                   (off_t)(j * rows * sizeof(uint32_t)));
+        for (size_t i = 0; (i < rows) && bOk; i++) {
+            if (row[i] != (uint32_t)(i * cols + j)) {
+                std::cout << boost::format("file: i = %d, j = %d\n") % i % j;
+                bOk = false;
+            }
+        }
+    }
+
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    double mb = 2.0 * rows * cols * sizeof(uint32_t) / 1e6;
+    std::cout << boost::format("%-16s %6d x %-6d %8.1f MB budget %8.2f sec "
+                               "%8.1f MB/s %8.1f MB max RSS %s\n")
+        % "file" % rows % cols % (budget / 1e6) % sec.count()
+        % (mb / sec.count()) % (ru.ru_maxrss / 1024.0)
+        % (bOk ? "ok" : "FAILED");
+
+    close(src);
+    close(dst);
+    unlink(path.c_str());
+    unlink(tpath.c_str());
+    return bOk ? 0 : 2;
+}
+
 int main(int argc, char *argv[])
 {
     size_t rows = 5;
     size_t cols = 9;
     int verbose = 0;
+    int repeat = 3;
+    size_t budget = 64;
 
     po::options_description desc("Allowed options");
     desc.add_options()
@@ -45,8 +459,24 @@ int main(int argc, char *argv[])
          "Verbose output level: 0, 1 or 2")
         ("rows", po::value<size_t>(&rows)->default_value(rows),
          "Number of rows (n)")
-        ("rows", po::value<size_t>(&rows)->default_value(rows),
-         "Number of columns (m)");
+        ("cols", po::value<size_t>(&cols)->default_value(cols),
+         "Number of columns (m)")
+        ("bench", po::value<std::string>(),
+         "Benchmark a rows x cols transpose:\n"
+         "<inplace | inplace_v1 | inplace_v2 | inplace_v3 | inplace_parallel |\n"
+         " blocked | recursive | simd | square | square_simd | all>")
+        ("threads", po::value<unsigned>(&nthreads)->default_value(nthreads),
+         "Number of threads for inplace_parallel (0 = all hardware threads)")
+        ("bench-batch", po::value<size_t>(),
+         "Benchmark transposing this many rows x cols arrays, one by one\n"
+         "and with array_2d_transpose_batch")
+        ("file", po::value<std::string>(),
+         "Out-of-core transpose of a rows x cols array of 32-bit values\n"
+         "written to this file (removed afterwards)")
+        ("budget", po::value<size_t>(&budget)->default_value(budget),
+         "Memory budget of the out-of-core transpose, MB")
+        ("repeat", po::value<int>(&repeat)->default_value(repeat),
+         "Number of benchmark runs (the best one is reported)");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -57,40 +487,80 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    for (size_t n = 1; n <= rows; n++) {
-        for (size_t m = 1; m <= cols; m++) {
+    if (vm.count("file")) {
+        return bench_transpose_file(vm["file"].as<std::string>(),
+                                    rows, cols, budget << 20);
+    }
+
+    if (vm.count("bench-batch")) {
+        bench_transpose_batch(rows, cols, vm["bench-batch"].as<size_t>());
+        return 0;
+    }
 
-            array arr1(n * m);
-            for (size_t i = 0; i < arr1.size(); i++) {
-                arr1[i] = i;
+    if (vm.count("bench")) {
+        const std::string &name = vm["bench"].as<std::string>();
+        bool found = false;
+        for (auto &ta : transpose_algos()) {
+            if ((name == ta.name || name == "all") &&
+                (!ta.square_only || rows == cols)) {
+                bench_transpose(ta, rows, cols, repeat);
+                found = true;
             }
+        }
+        if (!found) {
+            std::cout << desc << std::endl;
+            return 1;
+        }
+        return 0;
+    }
 
-            array arr2 = arr1;
-            algo::array_2d_transpose(arr2.begin(), n, m);
-
-            bool bOk = true;
-            for (size_t i = 0; (i < n) && bOk; i++) {
-                for (size_t j = 0; (j < m) && bOk; j++) {
-                    if (arr1[m*i+j] != arr2[n*j+i]) {
-                        bOk = false;
-                        std::cout <<
-                            boost::format("n = %d, m = %d, i = %d, j = %d\n"
-                                          "arr1[m*i+j = %d] = %d\n"
-                                          "arr2[n*j+i = %d] = %d\n")
-                            % n % m % i % j
-                            % (m*i+j) % (arr1[m*i+j])
-                            % (n*j+i) % (arr2[n*j+i]);
-                    }
+    int ret = 0;
+    if (!check_mulmod()) {
+        ret = 2;
+    }
+    for (size_t n : { 1, 2, 3, 7, 16, 17 }) {
+        for (size_t m : { 1, 2, 3, 7, 16, 17 }) {
+            if (!check_transpose_batch(n, m, 11) ||
+                !check_transpose_strided(n, m) ||
+                !check_transpose_move_only(n, m)) {
+                ret = 2;
+            }
+        }
+    }
+    for (size_t budget : { 8, 64, 1000, 1 << 20 }) {
+        for (size_t n : { 1, 3, 17, 64, 100 }) {
+            for (size_t m : { 1, 5, 17, 64, 130 }) {
+                if (!check_transpose_file(n, m, budget)) {
+                    ret = 2;
                 }
             }
-
-            if (!bOk) {
-                std::cout << "\narr1 (original)  : ";
-                print_array_1d(arr1, n*m);
-                print_array_2d(arr1, n, m);
-                std::cout << "\narr2 (transposed): ";
-                print_array_1d(arr2, n*m);
-                print_array_2d(arr2, m, n);
+        }
+    }
+    if (!check_transpose_strided(65, 130) ||
+        !check_transpose_strided(130, 129)) {
+        ret = 2;
+    }
+    for (size_t n : { 1, 2, 3, 4, 5, 8, 9, 17, 64, 65 }) {
+        for (size_t m : { 1, 2, 3, 4, 5, 8, 9, 17, 64, 65 }) {
+            if (!check_transpose_simd_double(n, m)) {
+                ret = 2;
+            }
+        }
+    }
+    for (auto &ta : transpose_algos()) {
+        for (size_t n = 1; n <= rows; n++) {
+            for (size_t m = 1; m <= cols; m++) {
+                if (!check_transpose(ta, n, m)) {
+                    ret = 2;
+                }
+            }
+        }
+        // sizes around the tile and the register tile boundaries
+        for (size_t n : { 7, 8, 9, 63, 64, 65, 100, 130 }) {
+            for (size_t m : { 1, 2, 7, 8, 9, 63, 64, 65, 100, 129, 130 }) {
+                if (!check_transpose(ta, n, m)) {
+                    ret = 2;
+                }
             }
         }
     }
@@ -108,5 +578,5 @@ int main(int argc, char *argv[])
     std::cout << "\nTransposed array:" << std::endl;
     print_array_2d(arr, cols, rows);
 
-    return 0;
+    return ret;
 }
@@ -0,0 +1,30 @@
+#!/usr/bin/python
+
+import sys
+sys.path.append('../test_utils')
+import test_utils
+
+def tc01_file():
+    # 32768 x 40000 32-bit values = 5.2 GB, a 64 MB budget
+    seq = [4096, 8192, 16384, 32768]
+    cmd = "./array_2d_transpose --file big.bin --rows $x --cols 40000 --budget 64"
+
+    test_utils.run_seq("Testing out-of-core transpose (64 MB budget):",
+                       seq, cmd, "out_file")
+
+def tc02_file_budget():
+    seq = [4, 16, 64, 256, 1024]
+    cmd = "./array_2d_transpose --file big.bin --rows 16384 --cols 40000 --budget $x"
+
+    test_utils.run_seq("Testing out-of-core transpose (2.6 GB, budget in MB):",
+                       seq, cmd, "out_file_budget")
+
+def run_tests():
+    tc01_file()
+    tc02_file_budget()
+
+def main():
+    run_tests()
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,220 @@
+#include <vector>
+#include <iterator>
+#include <algorithm> // std::next_permutation()
+#include <iostream>  // std::cout
+#include <string>
+#include <sstream>
+#include <stdlib.h>  // rand()
+#include <chrono>
+#include <functional>
+
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+
+#include "algo/array_nd_transpose.hpp"
+
+namespace po = boost::program_options;
+
+using array = std::vector<int>;
+using dims_t = std::vector<size_t>;
+
+std::string to_string(const dims_t &v)
+{
+    std::ostringstream ss;
+    for (size_t i = 0; i < v.size(); i++) {
+        ss << (i ? "," : "") << v[i];
+    }
+    return ss.str();
+}
+
+// element by element, straight from the definition
+void transpose_naive(const array &src, array &dst,
+                     const dims_t &dims, const dims_t &perm)
+{
+    const size_t r = dims.size();
+    dims_t sstr(r, 1), idx(r, 0);
+    for (size_t k = r; k-- > 1; ) {
+        sstr[k - 1] = sstr[k] * dims[k];
+    }
+    for (size_t o = 0; o < dst.size(); o++) {
+        size_t s = 0;
+        for (size_t k = 0; k < r; k++) {
+            s += idx[k] * sstr[perm[k]];
+        }
+        dst[o] = src[s];
+        for (size_t k = r; k-- > 0; ) {
+            if (++idx[k] < dims[perm[k]]) {
+                break;
+            }
+            idx[k] = 0;
+        }
+    }
+}
+
+bool check_transpose(const dims_t &dims, const dims_t &perm)
+{
+    size_t total = 1;
+    for (size_t d : dims) {
+        total *= d;
+    }
+
+    array arr(total), ref(total), out(total, -1);
+    for (size_t i = 0; i < total; i++) {
+        arr[i] = i;
+    }
+    transpose_naive(arr, ref, dims, perm);
+
+    algo::array_nd_transpose(arr.begin(), out.begin(), dims, perm);
+    array inp = arr;
+    algo::array_nd_transpose(inp.begin(), dims, perm);
+
+    if (out != ref || inp != ref) {
+        std::cout << boost::format("%s: dims = { %s }, perm = { %s }\n")
+            % (out != ref ? "out-of-place" : "in-place")
+            % to_string(dims) % to_string(perm);
+        return false;
+    }
+    return true;
+}
+
+// all permutations of random dims of all ranks up to maxrank
+bool check_transpose_all(size_t maxrank, size_t maxdim, int tries)
+{
+    bool bOk = true;
+    for (size_t r = 1; r <= maxrank; r++) {
+        for (int t = 0; t < tries; t++) {
+            dims_t dims(r), perm(r);
+            for (size_t k = 0; k < r; k++) {
+                dims[k] = 1 + rand() % maxdim;
+                perm[k] = k;
+            }
+            do {
+                bOk = check_transpose(dims, perm) && bOk;
+            } while (std::next_permutation(perm.begin(), perm.end()));
+        }
+    }
+    return bOk;
+}
+
+void bench_transpose(const dims_t &dims, const dims_t &perm, int repeat)
+{
+    size_t total = 1;
+    for (size_t d : dims) {
+        total *= d;
+    }
+    array arr(total), out(total);
+    for (size_t i = 0; i < total; i++) {
+        arr[i] = i;
+    }
+
+    auto run = [ & ] (const char *name, std::function<void()> func) {
+        double best = 0;
+        for (int r = 0; r < repeat; r++) {
+            auto t0 = std::chrono::steady_clock::now();
+            func();
+            std::chrono::duration<double> sec =
+                std::chrono::steady_clock::now() - t0;
+            if (r == 0 || sec.count() < best) {
+                best = sec.count();
+            }
+        }
+        double gb = 2.0 * total * sizeof(array::value_type) / 1e9;
+        std::cout << boost::format("%-12s { %s } -> { %s } %8.4f sec "
+                                   "%8.2f GB/s\n")
+            % name % to_string(dims) % to_string(perm) % best % (gb / best);
+    };
+
+    run("naive", [ & ] { transpose_naive(arr, out, dims, perm); });
+    run("outofplace", [ & ] {
+            algo::array_nd_transpose(arr.begin(), out.begin(), dims, perm); });
+    run("inplace", [ & ] {
+            // the permuted array is permuted again on the next run,
+            // which costs the same for the benchmarked permutations
+            algo::array_nd_transpose(arr.begin(), dims, perm); });
+}
+
+dims_t parse_dims(const std::string &s)
+{
+    dims_t v;
+    std::istringstream ss(s);
+    std::string x;
+    while (std::getline(ss, x, ',')) {
+        v.push_back(std::stoul(x));
+    }
+    return v;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t maxrank = 5;
+    size_t maxdim = 5;
+    int tries = 5;
+    int repeat = 3;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "Show help")
+        ("maxrank", po::value<size_t>(&maxrank)->default_value(maxrank),
+         "Check all permutations of random arrays of up to this rank")
+        ("maxdim", po::value<size_t>(&maxdim)->default_value(maxdim),
+         "Maximum size of an axis in the checks")
+        ("tries", po::value<int>(&tries)->default_value(tries),
+         "Number of random arrays per rank in the checks")
+        ("bench", po::value<std::string>(),
+         "Benchmark the permutation of an array with these dims,\n"
+         "e.g. 32,64,56,56")
+        ("perm", po::value<std::string>()->default_value("0,2,3,1"),
+         "Permutation for --bench (NCHW -> NHWC by default)")
+        ("repeat", po::value<int>(&repeat)->default_value(repeat),
+         "Number of benchmark runs (the best one is reported)");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("bench")) {
+        dims_t dims = parse_dims(vm["bench"].as<std::string>());
+        dims_t perm = parse_dims(vm["perm"].as<std::string>());
+        if (dims.size() != perm.size()) {
+            std::cout << desc << std::endl;
+            return 1;
+        }
+        bench_transpose(dims, perm, repeat);
+        return 0;
+    }
+
+    int ret = 0;
+
+    // the usual suspects, empty arrays, then larger arrays for the blocked
+    // and the batched paths
+    const std::vector<std::pair<dims_t, dims_t>> cases = {
+        { { 2, 3, 4, 5 }, { 0, 2, 3, 1 } },
+        { { 2, 4, 5, 3 }, { 0, 3, 1, 2 } },
+        { { 3, 1, 4, 1 }, { 3, 2, 1, 0 } },
+        { { 1, 1, 1 }, { 2, 0, 1 } },
+        { { 3, 0, 2 }, { 1, 0, 2 } },
+        { { 3, 0, 2 }, { 2, 1, 0 } },
+        { { 0, 5 }, { 1, 0 } },
+        { { 7, 100, 130 }, { 0, 2, 1 } },
+        { { 3, 65, 40, 3 }, { 0, 2, 3, 1 } },
+        { { 130, 70 }, { 1, 0 } },
+        { { 20, 30, 40 }, { 2, 1, 0 } },
+        { { 20, 30, 40 }, { 1, 0, 2 } },
+    };
+    for (auto &c : cases) {
+        if (!check_transpose(c.first, c.second)) {
+            ret = 2;
+        }
+    }
+    if (!check_transpose_all(maxrank, maxdim, tries)) {
+        ret = 2;
+    }
+
+    std::cout << (ret ? "FAILED" : "OK") << std::endl;
+    return ret;
+}
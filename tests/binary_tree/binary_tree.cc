@@ -5,15 +5,27 @@
 #include <functional>  // std::bind
 #include <stdlib.h>    // rand()
 #include <time.h>      // time()
+#include <chrono>
+#include <atomic>
+#include <sstream>
+#include <stdexcept>   // std::runtime_error
+#include <stdint.h>    // uint32_t, uint64_t
+#include <unistd.h>    // write(), close(), unlink()
+#include <sys/mman.h>  // mmap()
 
 //#include <boost/program_options.hpp>
 //#include <boost/format.hpp>
 
 #include "algo/binary_tree.hpp"
+#include "algo/binary_tree_eytzinger.hpp"
+#include "algo/binary_tree_parallel.hpp"
+#include "algo/binary_tree_serialize.hpp"
 
 using namespace std::placeholders;
 
 using BinaryTreeNode = algo::binary_tree_node<int>;
+using AvlTreeNode = algo::binary_tree_avl_node<int>;
+using OsTreeNode = algo::binary_tree_os_node<int>;
 
 template <typename V>
 void print_vector(const char *msg, const V &v) {
@@ -23,6 +35,23 @@ void print_vector(const char *msg, const V &v) {
     std::cout << std::endl;
 }
 
+// A copy of an iterator taken halfway through a traversal resumes from the
+// same node, and leaves the original where it was
+template <typename Range>
+bool check_iterator_copy(const Range &range,
+                         const std::vector<BinaryTreeNode*> &ref)
+{
+    const size_t half = ref.size() / 2;
+    auto it = range.begin();
+    std::advance(it, half);
+    std::vector<BinaryTreeNode*> rest;
+    for (auto copy = it; copy != range.end(); ++copy)
+        rest.push_back(&*copy);
+    return rest == std::vector<BinaryTreeNode*>(ref.begin() + half,
+                                                ref.end()) &&
+           (it == range.end() || &*it == ref[half]);
+}
+
 void run_traversals(BinaryTreeNode *root)
 {
     auto v2v = [ ] (BinaryTreeNode *n, std::vector<BinaryTreeNode *> *v) {
@@ -44,29 +73,129 @@ void run_traversals(BinaryTreeNode *root)
     algo::binary_tree_traverse_postorder1(root, std::bind(v2v, _1, &vpost1));
     algo::binary_tree_traverse_postorder2(root, std::bind(v2v, _1, &vpost2));
 
+    std::vector<BinaryTreeNode*> vinm, vprem, vpostm;
+    algo::binary_tree_traverse_inorder_morris(root, std::bind(v2v, _1, &vinm));
+    algo::binary_tree_traverse_preorder_morris(root,
+                                               std::bind(v2v, _1, &vprem));
+    algo::binary_tree_traverse_postorder_morris(root,
+                                                std::bind(v2v, _1, &vpostm));
+
+    // iterators
+    auto n2v = [ ] (BinaryTreeNode &n) { return &n; };
+    std::vector<BinaryTreeNode*> viniter, vpreiter, vpostiter, vlevelsiter;
+    auto in = algo::binary_tree_inorder(root);
+    std::transform(in.begin(), in.end(), std::back_inserter(viniter), n2v);
+    auto pre = algo::binary_tree_preorder(root);
+    std::transform(pre.begin(), pre.end(), std::back_inserter(vpreiter), n2v);
+    for (BinaryTreeNode &node : algo::binary_tree_postorder(root))
+        vpostiter.push_back(&node);
+    for (BinaryTreeNode &node : algo::binary_tree_levels(root))
+        vlevelsiter.push_back(&node);
+
     std::cout << std::endl;
     print_vector("in   order:", vinr);
     print_vector("pre  order:", vprer);
     print_vector("post order:", vpostr);
 
-    if (vinr != vin) {
+    if (vinr != vin || vinr != vinm || vinr != viniter) {
         std::cout << "Error!" << std::endl;
         print_vector("  vinr :", vinr);
         print_vector("  vin  :", vin);
+        print_vector("  vinm :", vinm);
+        print_vector("  viniter :", viniter);
     }
-    if (vprer != vpre) {
+    if (vprer != vpre || vprer != vprem || vprer != vpreiter) {
         std::cout << "Error!" << std::endl;
         print_vector("  vprer :", vprer);
         print_vector("  vpre  :", vpre);
+        print_vector("  vprem :", vprem);
+        print_vector("  vpreiter :", vpreiter);
     }
-    if (vpostr != vpost || vpostr != vpost1 || vpost1 != vpost2) {
+    if (vpostr != vpost || vpostr != vpost1 || vpost1 != vpost2 ||
+        vpostr != vpostm || vpostr != vpostiter) {
         std::cout << "Error!" << std::endl;
         print_vector("  vpostr :", vpostr);
         print_vector("  vpost  :", vpost);
         print_vector("  vpost1 :", vpost1);
         print_vector("  vpost2 :", vpost2);
+        print_vector("  vpostm :", vpostm);
+        print_vector("  vpostiter :", vpostiter);
+    }
+    if (!check_iterator_copy(in, viniter) ||
+        !check_iterator_copy(pre, vpreiter) ||
+        !check_iterator_copy(algo::binary_tree_postorder(root), vpostiter) ||
+        !check_iterator_copy(algo::binary_tree_levels(root), vlevelsiter)) {
+        std::cout << "iterator copy: Error!" << std::endl;
     }
 
+    // every traversal stopped by its visitor after k nodes visits the first
+    // k nodes, and leaves the tree as it was (Morris ones)
+    typedef std::function<bool(BinaryTreeNode*,
+                               std::function<bool(BinaryTreeNode*)>)> trav;
+    typedef std::function<bool(BinaryTreeNode*)> visitor;
+    const std::vector<std::pair<trav, std::vector<BinaryTreeNode*>*>> travs = {
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_inorder(r, v); }, &vinr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_inorder_r(r, v); }, &vinr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_inorder_morris(r, v); },
+          &vinr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_preorder(r, v); }, &vprer },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_preorder_r(r, v); }, &vprer },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_preorder_morris(r, v); },
+          &vprer },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_postorder(r, v); },
+          &vpostr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_postorder1(r, v); },
+          &vpostr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_postorder2(r, v); },
+          &vpostr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_postorder_r(r, v); },
+          &vpostr },
+        { [ ] (BinaryTreeNode *r, visitor v) {
+                return algo::binary_tree_traverse_postorder_morris(r, v); },
+          &vpostr },
+    };
+    for (size_t t = 0; t < travs.size(); t++) {
+        const std::vector<BinaryTreeNode*> &full = *travs[t].second;
+        for (size_t k = 1; k <= full.size(); k++) {
+            std::vector<BinaryTreeNode*> v;
+            bool done = travs[t].first(root, [ & ] (BinaryTreeNode *n) {
+                    v.push_back(n);
+                    return v.size() < k;
+                });
+            std::vector<BinaryTreeNode*> after;
+            algo::binary_tree_traverse_preorder(root, std::bind(v2v, _1,
+                                                                &after));
+            if (done != (k > full.size()) ||
+                v != std::vector<BinaryTreeNode*>(full.begin(),
+                                                  full.begin() + k) ||
+                after != vprer) {
+                std::cout << "Error! (traversal " << t << " stopped after "
+                          << k << " nodes)" << std::endl;
+            }
+        }
+    }
+
+    // a visitor returning a count (0 first) is not a stop signal
+    // (null nodes are the level markers of the level-order)
+    size_t count = 0;
+    auto counter = [ & ] (BinaryTreeNode *n) { return n ? count++ : count; };
+    bool counted = algo::binary_tree_traverse_inorder(root, counter) &&
+                   algo::binary_tree_traverse_preorder_morris(root, counter) &&
+                   algo::binary_tree_traverse_postorder(root, counter) &&
+                   algo::binary_tree_traverse_levels(root, counter);
+    if (!counted || count != 4 * vinr.size())
+        std::cout << "Error! (counting visitor)" << std::endl;
+
     std::vector<BinaryTreeNode *> levels;
     algo::binary_tree_traverse_levels(root, std::bind(v2v, _1, &levels));
 
@@ -74,6 +203,13 @@ void run_traversals(BinaryTreeNode *root)
     print_vector("h. levels :", levels);
     std::cout << std::endl;
 
+    levels.erase(std::remove(levels.begin(), levels.end(), nullptr),
+                 levels.end());
+    if (levels != vlevelsiter) {
+        std::cout << "Error!" << std::endl;
+        print_vector("  vlevelsiter :", vlevelsiter);
+    }
+
     bool is_bst = algo::binary_tree_is_bst(root);
     std::cout << std::endl;
     std::cout << "Is BST      : " << is_bst << std::endl;
@@ -81,8 +217,907 @@ void run_traversals(BinaryTreeNode *root)
     bool is_balanced = algo::binary_tree_is_balanced(root);
     std::cout << "Is balanced : " << is_balanced << std::endl;
     std::cout << std::endl;
+
+    for (unsigned nthreads : { 1, 2, 3 }) {
+        if (algo::binary_tree_is_bst_parallel(root, std::less<int>(),
+                                              nthreads) != is_bst ||
+            algo::binary_tree_is_balanced_parallel(root, nthreads) !=
+            is_balanced) {
+            std::cout << "Error! (parallel, " << nthreads << " threads)"
+                      << std::endl;
+        }
+    }
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+// The same random BST of n nodes built with new/delete and in a node pool:
+// insertion, an inorder traversal, and the teardown.
+// Returns false if the trees differ.
+bool run_pool_benchmark(int n)
+{
+    std::vector<int> keys(n);
+    for (auto &k : keys)
+        k = rand();
+
+    auto build = [ & ] (std::function<void(int)> insert) {
+        for (int i = 1; i < n; i++)
+            insert(keys[i]);
+    };
+    uint64_t heap_sum = 0, pool_sum = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    BinaryTreeNode *root = algo::binary_tree_new_node<BinaryTreeNode>(keys[0]);
+    build([ & ] (int k) { algo::binary_tree_insert_bst(root, k); });
+    double heap_insert = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(root, [ & ] (BinaryTreeNode *node) {
+            heap_sum = heap_sum * 31 + node->data; });
+    double heap_traverse = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_destroy_tree(root);
+    double heap_destroy = seconds_since(t0);
+
+    algo::binary_tree_node_pool<BinaryTreeNode> pool;
+
+    t0 = std::chrono::steady_clock::now();
+    root = algo::binary_tree_new_node(pool, keys[0]);
+    build([ & ] (int k) { algo::binary_tree_insert_bst(pool, root, k); });
+    double pool_insert = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(root, [ & ] (BinaryTreeNode *node) {
+            pool_sum = pool_sum * 31 + node->data; });
+    double pool_traverse = seconds_since(t0);
+
+    size_t nodes = pool.size();
+    t0 = std::chrono::steady_clock::now();
+    pool.release();
+    double pool_destroy = seconds_since(t0);
+
+    std::cout << "random BST of " << n << " nodes (" << nodes << " unique):"
+              << std::endl;
+    std::cout << "          insert   traverse   destroy (sec)" << std::endl;
+    std::cout << "new/delete " << heap_insert << "  " << heap_traverse
+              << "  " << heap_destroy << std::endl;
+    std::cout << "node pool  " << pool_insert << "  " << pool_traverse
+              << "  " << pool_destroy << std::endl;
+
+    // a node destroyed one by one is reused by the next insert
+    root = algo::binary_tree_new_node(pool, 2);
+    BinaryTreeNode *node = algo::binary_tree_insert_bst(pool, root, 1);
+    root->left = nullptr;
+    algo::binary_tree_destroy_node(pool, node);
+    bool reused = algo::binary_tree_insert_bst(pool, root, 3) == node &&
+                  pool.size() == 2;
+    algo::binary_tree_destroy_tree(pool, root);
+
+    if (heap_sum != pool_sum || !reused || pool.size() != 0) {
+        std::cout << "Error!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Inserts and erases random values into an AVL tree and checks it against
+// a sorted vector after every step
+bool check_avl(int n, int range)
+{
+    algo::binary_tree_node_pool<AvlTreeNode> pool;
+    AvlTreeNode *root = nullptr;
+    std::vector<int> ref;
+
+    for (int i = 0; i < n; i++) {
+        int value = rand() % range;
+        auto it = std::lower_bound(ref.begin(), ref.end(), value);
+        bool found = it != ref.end() && *it == value;
+        if (rand() % 3) {
+            algo::binary_tree_insert_avl(pool, root, value);
+            if (!found)
+                ref.insert(it, value);
+        } else {
+            if (algo::binary_tree_erase_avl(pool, root, value) != found)
+                return false;
+            if (found)
+                ref.erase(it);
+        }
+
+        std::vector<int> v;
+        bool heights_ok = true;
+        algo::binary_tree_traverse_inorder(root, [ & ] (AvlTreeNode *node) {
+                v.push_back(node->data);
+                int hl = algo::binary_tree_avl_height(node->left);
+                int hr = algo::binary_tree_avl_height(node->right);
+                heights_ok = heights_ok && std::abs(hl - hr) <= 1 &&
+                             node->height == std::max(hl, hr) + 1;
+            });
+        if (v != ref || !heights_ok || pool.size() != ref.size())
+            return false;
+    }
+    return true;
+}
+
+// Insertion of n sorted and n random keys into a plain BST and an AVL tree,
+// then a search of every key
+void run_avl_benchmark(int n)
+{
+    std::vector<int> sorted(n), shuffled(n);
+    for (int i = 0; i < n; i++)
+        sorted[i] = shuffled[i] = i;
+    std::random_shuffle(shuffled.begin(), shuffled.end());
+
+    std::cout << "BST vs AVL, " << n << " nodes:" << std::endl;
+    std::cout << "               insert   search (sec)" << std::endl;
+
+    for (int order = 0; order < 2; order++) {
+        const std::vector<int> &keys = order ? shuffled : sorted;
+        const char *name = order ? "random" : "sorted";
+
+        algo::binary_tree_node_pool<BinaryTreeNode> bst_pool;
+        auto t0 = std::chrono::steady_clock::now();
+        BinaryTreeNode *bst = algo::binary_tree_new_node(bst_pool, keys[0]);
+        for (int i = 1; i < n; i++)
+            algo::binary_tree_insert_bst(bst_pool, bst, keys[i]);
+        double bst_insert = seconds_since(t0);
+        t0 = std::chrono::steady_clock::now();
+        size_t found = 0;
+        for (int i = 0; i < n; i++)
+            found += algo::binary_tree_search_bst(bst, keys[i]) != nullptr;
+        double bst_search = seconds_since(t0);
+
+        algo::binary_tree_node_pool<AvlTreeNode> avl_pool;
+        AvlTreeNode *avl = nullptr;
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++)
+            algo::binary_tree_insert_avl(avl_pool, avl, keys[i]);
+        double avl_insert = seconds_since(t0);
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < n; i++)
+            found += algo::binary_tree_search_bst(avl, keys[i]) != nullptr;
+        double avl_search = seconds_since(t0);
+
+        std::cout << "BST " << name << "  " << bst_insert << "  "
+                  << bst_search << std::endl;
+        std::cout << "AVL " << name << "  " << avl_insert << "  "
+                  << avl_search << " (height " << avl->height << ")"
+                  << (found == 2 * (size_t)n ? "" : " Error!") << std::endl;
+    }
+}
+
+// Inserts and erases random values into an order statistic tree and checks
+// the sizes, select, rank and range counts against a sorted vector
+bool check_os(int n, int range)
+{
+    algo::binary_tree_node_pool<OsTreeNode> pool;
+    OsTreeNode *root = nullptr;
+    std::vector<int> ref;
+
+    for (int i = 0; i < n; i++) {
+        int value = rand() % range;
+        auto it = std::lower_bound(ref.begin(), ref.end(), value);
+        bool found = it != ref.end() && *it == value;
+        if (rand() % 3) {
+            algo::binary_tree_insert_os(pool, root, value);
+            if (!found)
+                ref.insert(it, value);
+        } else {
+            if (algo::binary_tree_erase_os(pool, root, value) != found)
+                return false;
+            if (found)
+                ref.erase(it);
+        }
+
+        bool sizes_ok = true;
+        algo::binary_tree_traverse_postorder(root, [ & ] (OsTreeNode *node) {
+                sizes_ok = sizes_ok && node->size ==
+                    algo::binary_tree_os_size(node->left) +
+                    algo::binary_tree_os_size(node->right) + 1;
+            });
+        if (!sizes_ok || algo::binary_tree_os_size(root) != ref.size())
+            return false;
+
+        for (size_t k = 0; k <= ref.size(); k++) {
+            OsTreeNode *node = algo::binary_tree_select(root, k);
+            if (k < ref.size() ? !node || node->data != ref[k] : !!node)
+                return false;
+        }
+        int lo = rand() % (range + 2) - 1, hi = rand() % (range + 2) - 1;
+        size_t rank = std::lower_bound(ref.begin(), ref.end(), lo) -
+                      ref.begin();
+        size_t count = hi < lo ? 0 :
+            std::upper_bound(ref.begin(), ref.end(), hi) -
+            std::lower_bound(ref.begin(), ref.end(), lo);
+        if (algo::binary_tree_rank(root, lo) != rank ||
+            algo::binary_tree_count_range(root, lo, hi) != count)
+            return false;
+    }
+    algo::binary_tree_destroy_tree(pool, root);
+    return pool.size() == 0;
+}
+
+// select, rank and range counts in an order statistic tree of n random keys
+// vs counting by inorder traversals (stopped as soon as possible)
+bool run_os_benchmark(int n, int queries)
+{
+    algo::binary_tree_node_pool<AvlTreeNode> avl_pool;
+    algo::binary_tree_node_pool<OsTreeNode> os_pool;
+    AvlTreeNode *avl = nullptr;
+    OsTreeNode *root = nullptr;
+    std::vector<int> keys(n);
+    for (auto &k : keys)
+        k = rand() % n;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k : keys)
+        algo::binary_tree_insert_avl(avl_pool, avl, k);
+    double avl_insert = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    for (int k : keys)
+        algo::binary_tree_insert_os(os_pool, root, k);
+    double os_insert = seconds_since(t0);
+    size_t size = algo::binary_tree_os_size(root);
+
+    std::vector<int> lo(queries), hi(queries);
+    for (int i = 0; i < queries; i++) {
+        lo[i] = rand() % n;
+        hi[i] = lo[i] + rand() % (n / 10 + 1);
+    }
+
+    // the same sums from both, or the counting is wrong
+    long long os_sum = 0, walk_sum = 0;
+    double os[3], walk[3];
+
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++)
+        os_sum += algo::binary_tree_select(root, lo[i] % size)->data;
+    os[0] = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++)
+        os_sum += algo::binary_tree_rank(root, lo[i]);
+    os[1] = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++)
+        os_sum += algo::binary_tree_count_range(root, lo[i], hi[i]);
+    os[2] = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        size_t k = lo[i] % size;
+        algo::binary_tree_traverse_inorder(root, [ & ] (OsTreeNode *node) {
+                if (k-- > 0)
+                    return true;
+                walk_sum += node->data;
+                return false;
+            });
+    }
+    walk[0] = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        algo::binary_tree_traverse_inorder(root, [ & ] (OsTreeNode *node) {
+                walk_sum += node->data < lo[i];
+                return node->data < lo[i];
+            });
+    }
+    walk[1] = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < queries; i++) {
+        algo::binary_tree_traverse_inorder(root, [ & ] (OsTreeNode *node) {
+                walk_sum += node->data >= lo[i] && node->data <= hi[i];
+                return node->data <= hi[i];
+            });
+    }
+    walk[2] = seconds_since(t0);
+
+    std::cout << "order statistics of " << size << " keys, " << queries
+              << " queries (usec per query):" << std::endl;
+    std::cout << "insert " << n << " keys: AVL " << avl_insert
+              << " sec, with sizes " << os_insert << " sec" << std::endl;
+    const char *names[] = { "select     ", "rank       ", "count_range" };
+    for (int i = 0; i < 3; i++) {
+        std::cout << names[i] << "  " << os[i] / queries * 1e6
+                  << "  traversal " << walk[i] / queries * 1e6 << std::endl;
+    }
+
+    if (os_sum != walk_sum) {
+        std::cout << "Error!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Searches of random keys (about half of them present) in a random BST of
+// n nodes and in its flat Eytzinger layout
+bool run_eytzinger_benchmark(int n)
+{
+    std::vector<int> keys(n), queries(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = rand() % (2 * n);
+        queries[i] = rand() % (2 * n);
+    }
+
+    BinaryTreeNode *root = algo::binary_tree_new_node<BinaryTreeNode>(keys[0]);
+    for (int i = 1; i < n; i++)
+        algo::binary_tree_insert_bst(root, keys[i]);
+
+    auto t0 = std::chrono::steady_clock::now();
+    auto flat = algo::binary_tree_to_eytzinger(root);
+    double build = seconds_since(t0);
+
+    size_t bst_found = 0, flat_found = 0;
+    bool same = true;
+
+    t0 = std::chrono::steady_clock::now();
+    for (int q : queries)
+        bst_found += algo::binary_tree_search_bst(root, q) != nullptr;
+    double bst_search = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    for (int q : queries)
+        flat_found += flat.search(q) != nullptr;
+    double flat_search = seconds_since(t0);
+
+    // lower_bound against the sorted keys, including the ends
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    queries.push_back(-1);
+    queries.push_back(2 * n);
+    for (int q : queries) {
+        auto it = std::lower_bound(keys.begin(), keys.end(), q);
+        const int *lb = flat.lower_bound(q);
+        same = same && (it == keys.end() ? !lb : lb && *lb == *it);
+    }
+    algo::binary_tree_destroy_tree(root);
+
+    std::cout << "search of " << n << " keys in BST vs Eytzinger layout:"
+              << std::endl;
+    std::cout << "BST        " << bst_search << " sec, "
+              << n / bst_search / 1e6 << " M/s" << std::endl;
+    std::cout << "Eytzinger  " << flat_search << " sec, "
+              << n / flat_search / 1e6 << " M/s (built in " << build
+              << " sec)" << std::endl;
+
+    if (bst_found != flat_found || flat.size() != keys.size() || !same) {
+        std::cout << "Error!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Stack-based, Morris and recursive traversals of a wide tree (random BST)
+// and a deep one (a chain of left children) of n nodes
+bool run_traversal_benchmark(int n)
+{
+    algo::binary_tree_node_pool<BinaryTreeNode> pool;
+    BinaryTreeNode *wide = algo::binary_tree_new_node(pool, rand());
+    for (int i = 1; i < n; i++)
+        algo::binary_tree_insert_bst(pool, wide, rand());
+    BinaryTreeNode *deep = nullptr;
+    for (int i = 0; i < n; i++) {
+        BinaryTreeNode *node = algo::binary_tree_new_node(pool, i);
+        node->left = deep;
+        deep = node;
+    }
+
+    bool ok = true;
+    auto run = [ & ] (const char *name, BinaryTreeNode *root,
+                      std::function<void(BinaryTreeNode*,
+                                         std::function<void(BinaryTreeNode*)>)>
+                      traverse) -> uint64_t {
+        uint64_t sum = 0;
+        auto t0 = std::chrono::steady_clock::now();
+        traverse(root, [ & ] (BinaryTreeNode *node) {
+                sum = sum * 31 + node->data; });
+        std::cout << name << " " << seconds_since(t0) << std::endl;
+        return sum;
+    };
+
+    std::cout << "traversals of " << n << " nodes (sec):" << std::endl;
+    for (int d = 0; d < 2; d++) {
+        BinaryTreeNode *root = d ? deep : wide;
+        std::string tree = d ? "deep " : "wide ";
+        typedef std::function<void(BinaryTreeNode*)> visitor;
+        uint64_t in = run((tree + "inorder   stack ").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_inorder(r, v); });
+        uint64_t inm = run((tree + "inorder   morris").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_inorder_morris(r, v); });
+        uint64_t pre = run((tree + "preorder  stack ").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_preorder(r, v); });
+        uint64_t prem = run((tree + "preorder  morris").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_preorder_morris(r, v); });
+        uint64_t post = run((tree + "postorder stack ").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_postorder(r, v); });
+        uint64_t postm = run((tree + "postorder morris").c_str(), root,
+            [ ] (BinaryTreeNode *r, visitor v) {
+                algo::binary_tree_traverse_postorder_morris(r, v); });
+        if (!d) {
+            // too deep for the recursion otherwise
+            uint64_t inr = run((tree + "inorder   recurs").c_str(), root,
+                [ ] (BinaryTreeNode *r, visitor v) {
+                    algo::binary_tree_traverse_inorder_r(r, v); });
+            ok = ok && in == inr;
+        }
+        ok = ok && in == inm && pre == prem && post == postm;
+    }
+
+    // early exit: the 10th node in the inorder
+    BinaryTreeNode *tenth = nullptr;
+    int count = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(wide, [ & ] (BinaryTreeNode *node) {
+            if (++count == 10)
+                tenth = node; });
+    double traverse = seconds_since(t0);
+
+    count = 0;
+    auto in = algo::binary_tree_inorder(wide);
+    t0 = std::chrono::steady_clock::now();
+    auto it = std::find_if(in.begin(), in.end(), [ & ] (BinaryTreeNode &) {
+            return ++count == 10; });
+    double find = seconds_since(t0);
+    std::cout << "wide 10th inorder node: traversal " << traverse
+              << ", std::find_if " << find << std::endl;
+    ok = ok && it.node() == tenth;
+
+    if (!ok)
+        std::cout << "Error!" << std::endl;
+    return ok;
+}
+
+// Sequential and parallel checks and teardown of a random BST and an AVL
+// tree of n nodes
+bool run_parallel_benchmark(int n, unsigned nthreads)
+{
+    std::vector<int> keys(n);
+    for (auto &k : keys)
+        k = rand();
+    BinaryTreeNode *bst = algo::binary_tree_new_node<BinaryTreeNode>(keys[0]);
+    AvlTreeNode *avl = nullptr;
+    for (int i = 0; i < n; i++) {
+        algo::binary_tree_insert_bst(bst, keys[i]);
+        algo::binary_tree_insert_avl(avl, keys[i]);
+    }
+
+    bool ok = true;
+    std::cout << "parallel (" << nthreads << " threads) vs sequential, "
+              << n << " nodes (sec):" << std::endl;
+
+    auto t0 = std::chrono::steady_clock::now();
+    bool seq = algo::binary_tree_is_bst(bst);
+    double seq_time = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    bool par = algo::binary_tree_is_bst_parallel(bst, std::less<int>(),
+                                                 nthreads);
+    double par_time = seconds_since(t0);
+    std::cout << "is_bst       " << seq_time << "  " << par_time << std::endl;
+    ok = ok && seq && par;
+
+    t0 = std::chrono::steady_clock::now();
+    seq = algo::binary_tree_is_balanced(avl);
+    seq_time = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    par = algo::binary_tree_is_balanced_parallel(avl, nthreads);
+    par_time = seconds_since(t0);
+    std::cout << "is_balanced  " << seq_time << "  " << par_time << std::endl;
+    ok = ok && seq && par && !algo::binary_tree_is_balanced_parallel(bst);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_destroy_tree(avl);
+    seq_time = seconds_since(t0);
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_destroy_tree_parallel(bst, nthreads);
+    par_time = seconds_since(t0);
+    std::cout << "destroy      " << seq_time << "  " << par_time << std::endl;
+
+    // A throwing task stops the others and reaches the caller after the join
+    bool caught = false;
+    std::atomic<int> done(0);
+    try {
+        algo::binary_tree_run_parallel(1000, nthreads, [&](size_t i) {
+            if (i == 10)
+                throw std::runtime_error("task failed");
+            done++;
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    ok = ok && caught && done < 1000;
+
+    if (!ok)
+        std::cout << "Error!" << std::endl;
+    return ok;
+}
+
+// Bulk builds and merges of small trees checked against sorted vectors,
+// then a tree of n random keys built by inserts and in bulk
+bool run_build_benchmark(int n)
+{
+    bool ok = true;
+    for (int size : { 0, 1, 2, 3, 7, 8, 100 }) {
+        std::vector<int> values(size), batch(size / 2 + 1);
+        for (auto &v : values)
+            v = rand() % (size + 1);
+        for (auto &v : batch)
+            v = rand() % (2 * size + 1);
+
+        std::vector<int> ref(values);
+        std::sort(ref.begin(), ref.end());
+        ref.erase(std::unique(ref.begin(), ref.end()), ref.end());
+        size_t built = ref.size();
+
+        algo::binary_tree_node_pool<BinaryTreeNode> pool;
+        BinaryTreeNode *root =
+            algo::binary_tree_build_bst(pool, values.begin(), values.end());
+        std::vector<int> v;
+        for (auto &node : algo::binary_tree_inorder(root))
+            v.push_back(node.data);
+        ok = ok && v == ref && algo::binary_tree_is_balanced(root);
+
+        ref.insert(ref.end(), batch.begin(), batch.end());
+        std::sort(ref.begin(), ref.end());
+        ref.erase(std::unique(ref.begin(), ref.end()), ref.end());
+
+        BinaryTreeNode *old_root = root;
+        size_t inserted = algo::binary_tree_merge_bst(pool, root, batch.begin(),
+                                                      batch.end());
+        v.clear();
+        for (auto &node : algo::binary_tree_inorder(root))
+            v.push_back(node.data);
+        ok = ok && v == ref && inserted == ref.size() - built &&
+             pool.size() == ref.size() &&
+             algo::binary_tree_is_bst(root) &&
+             algo::binary_tree_is_balanced(root) &&
+             (!old_root || algo::binary_tree_search_bst(root, old_root->data)
+                           == old_root);
+
+        // with new/delete, into an empty tree
+        BinaryTreeNode *heap_root = nullptr;
+        algo::binary_tree_merge_bst(heap_root, ref.begin(), ref.end());
+        BinaryTreeNode *heap_copy =
+            algo::binary_tree_build_bst<BinaryTreeNode>(ref.rbegin(),
+                                                        ref.rend());
+        ok = ok && algo::binary_tree_balanced_height(heap_root) ==
+                   algo::binary_tree_balanced_height(heap_copy);
+        algo::binary_tree_destroy_tree(heap_root);
+        algo::binary_tree_destroy_tree(heap_copy);
+
+        // the build and the merge set the heights and the subtree sizes, so
+        // an order statistic tree keeps working with inserts and selects
+        algo::binary_tree_node_pool<OsTreeNode> os_pool;
+        OsTreeNode *os =
+            algo::binary_tree_build_bst(os_pool, values.begin(), values.end());
+        algo::binary_tree_merge_bst(os_pool, os, batch.begin(), batch.end());
+        algo::binary_tree_insert_os(os_pool, os, 2 * size + 1);
+        bool os_ok = true;
+        algo::binary_tree_traverse_postorder(os, [ & ] (OsTreeNode *node) {
+                int hl = algo::binary_tree_avl_height(node->left);
+                int hr = algo::binary_tree_avl_height(node->right);
+                os_ok = os_ok && std::abs(hl - hr) <= 1 &&
+                        node->height == std::max(hl, hr) + 1 &&
+                        node->size == algo::binary_tree_os_size(node->left) +
+                                      algo::binary_tree_os_size(node->right) + 1;
+            });
+        for (size_t k = 0; os_ok && k < ref.size(); k++)
+            os_ok = algo::binary_tree_select(os, k)->data == ref[k];
+        ok = ok && os_ok && algo::binary_tree_os_size(os) == ref.size() + 1;
+    }
+
+    std::vector<int> keys(n);
+    for (auto &k : keys)
+        k = rand();
+    std::vector<int> sorted(keys);
+    std::sort(sorted.begin(), sorted.end());
+    sorted.erase(std::unique(sorted.begin(), sorted.end()), sorted.end());
+
+    algo::binary_tree_node_pool<BinaryTreeNode> insert_pool, build_pool,
+        sorted_pool;
+
+    auto t0 = std::chrono::steady_clock::now();
+    BinaryTreeNode *inserted = algo::binary_tree_new_node(insert_pool, keys[0]);
+    for (int i = 1; i < n; i++)
+        algo::binary_tree_insert_bst(insert_pool, inserted, keys[i]);
+    double insert = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    BinaryTreeNode *built =
+        algo::binary_tree_build_bst(build_pool, keys.begin(), keys.end());
+    double build = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    BinaryTreeNode *root =
+        algo::binary_tree_build_bst(sorted_pool, sorted.begin(), sorted.end());
+    double build_sorted = seconds_since(t0);
+
+    // one block in preorder
+    BinaryTreeNode *next = root;
+    algo::binary_tree_traverse_preorder(root, [ & ] (BinaryTreeNode *node) {
+            ok = ok && node == next++; });
+
+    uint64_t insert_sum = 0, build_sum = 0;
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(inserted, [ & ] (BinaryTreeNode *node) {
+            insert_sum = insert_sum * 31 + node->data; });
+    double insert_traverse = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(root, [ & ] (BinaryTreeNode *node) {
+            build_sum = build_sum * 31 + node->data; });
+    double build_traverse = seconds_since(t0);
+
+    // a batch of n/10 more keys
+    std::vector<int> batch(n / 10);
+    for (auto &k : batch)
+        k = rand();
+
+    t0 = std::chrono::steady_clock::now();
+    for (int k : batch)
+        algo::binary_tree_insert_bst(insert_pool, inserted, k);
+    double insert_batch = seconds_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_merge_bst(build_pool, built, batch.begin(), batch.end());
+    double merge_batch = seconds_since(t0);
+
+    std::cout << "BST of " << n << " random keys (sec):" << std::endl;
+    std::cout << "             build    traverse  add " << batch.size()
+              << std::endl;
+    std::cout << "inserts      " << insert << "  " << insert_traverse << "  "
+              << insert_batch << std::endl;
+    std::cout << "bulk         " << build << "  " << build_traverse << "  "
+              << merge_batch << " (merge)" << std::endl;
+    std::cout << "bulk, sorted " << build_sorted << std::endl;
+
+    ok = ok && insert_sum == build_sum &&
+         insert_pool.size() == build_pool.size() &&
+         algo::binary_tree_is_balanced(built);
+    if (!ok)
+        std::cout << "Error!" << std::endl;
+    return ok;
 }
 
+// Balance checks of a balanced tree of n nodes, and a diagram of a random
+// BST of m nodes (to a string)
+bool run_balance_print_benchmark(int n, int m)
+{
+    bool ok = true;
+    {
+        algo::binary_tree_node_pool<BinaryTreeNode> pool;
+        std::vector<int> keys(n);
+        for (int i = 0; i < n; i++)
+            keys[i] = i;
+        BinaryTreeNode *root =
+            algo::binary_tree_build_bst(pool, keys.begin(), keys.end());
+
+        auto t0 = std::chrono::steady_clock::now();
+        bool balanced = algo::binary_tree_is_balanced(root);
+        std::cout << "is_balanced of " << n << " nodes: " << seconds_since(t0)
+                  << " sec" << std::endl;
+
+        // unbalance it at the bottom left
+        BinaryTreeNode *node = root;
+        while (node->left)
+            node = node->left;
+        node->left = algo::binary_tree_new_node(pool, -1);
+        node->left->left = algo::binary_tree_new_node(pool, -2);
+        t0 = std::chrono::steady_clock::now();
+        bool unbalanced = !algo::binary_tree_is_balanced(root);
+        std::cout << "is_balanced of " << n << " nodes, unbalanced: "
+                  << seconds_since(t0) << " sec" << std::endl;
+        ok = balanced && unbalanced;
+
+        // is_bst of the same tree, out of order at the bottom left
+        // or at the very end (visited last)
+        node->left->left->data = 1;
+        t0 = std::chrono::steady_clock::now();
+        bool not_bst = !algo::binary_tree_is_bst(root);
+        std::cout << "is_bst of " << n << " nodes, out of order first: "
+                  << seconds_since(t0) << " sec" << std::endl;
+        node->left->left = nullptr;
+        node->left->data = node->data - 1;
+        node = root;
+        while (node->right)
+            node = node->right;
+        node->data = -3;
+        t0 = std::chrono::steady_clock::now();
+        bool not_bst_last = !algo::binary_tree_is_bst(root);
+        std::cout << "is_bst of " << n << " nodes, out of order last: "
+                  << seconds_since(t0) << " sec" << std::endl;
+        ok = ok && not_bst && not_bst_last;
+    }
+
+    algo::binary_tree_node_pool<BinaryTreeNode> pool;
+    BinaryTreeNode *root = algo::binary_tree_new_node(pool, rand());
+    for (int i = 1; i < m; i++)
+        algo::binary_tree_insert_bst(pool, root, rand());
+    std::ostringstream ss;
+    auto t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_print(root, ss);
+    std::cout << "print of " << pool.size() << " nodes: " << seconds_since(t0)
+              << " sec, " << ss.str().size() << " bytes" << std::endl;
+
+    if (!ok)
+        std::cout << "Error!" << std::endl;
+    return ok;
+}
+
+// Round trips of small random trees and broken buffers, then serialization,
+// loading and a mapped view of a random BST of n nodes
+bool run_serialize_benchmark(int n)
+{
+    using View = algo::binary_tree_serial_view<int>;
+    bool ok = true;
+
+    for (int size : { 0, 1, 2, 3, 7, 100 }) {
+        BinaryTreeNode *root = nullptr;
+        if (size > 0) {
+            root = algo::binary_tree_new_node<BinaryTreeNode>(rand());
+            for (int i = 1; i < size; i++)
+                algo::binary_tree_insert_randomly(root, rand());
+        }
+        std::vector<char> buf;
+        algo::binary_tree_serialize(root, buf);
+
+        algo::binary_tree_node_pool<BinaryTreeNode> pool;
+        BinaryTreeNode *loaded = nullptr;
+        std::vector<char> again;
+        ok = ok && algo::binary_tree_deserialize(pool, buf.data(), buf.size(),
+                                                 loaded);
+        algo::binary_tree_serialize(loaded, again);
+        std::stringstream s1, s2;
+        algo::binary_tree_print(root, s1);
+        algo::binary_tree_print(loaded, s2);
+        ok = ok && again == buf && s1.str() == s2.str() &&
+             pool.size() == (size_t)size;
+
+        // the view: the same nodes in preorder
+        std::vector<BinaryTreeNode*> nodes;
+        for (auto &node : algo::binary_tree_preorder(root))
+            nodes.push_back(&node);
+        View view;
+        ok = ok && view.open(buf.data(), buf.size()) &&
+             view.size() == nodes.size() &&
+             view.root() == (size ? 0 : View::npos);
+        for (uint32_t i = 0; ok && i < view.size(); i++) {
+            uint32_t l = view.left(i), r = view.right(i);
+            ok = view.data(i) == nodes[i]->data &&
+                 (l == View::npos ? !nodes[i]->left
+                                  : nodes[l] == nodes[i]->left) &&
+                 (r == View::npos ? !nodes[i]->right
+                                  : nodes[r] == nodes[i]->right);
+        }
+
+        // a second tree appended after it stays aligned
+        std::vector<char> two(buf);
+        size_t second = algo::binary_tree_serialize(root, two);
+        BinaryTreeNode *loaded2 = nullptr;
+        std::vector<char> again2;
+        ok = ok && buf.size() % 8 == 0 && second == buf.size() &&
+             algo::binary_tree_deserialize(pool, two.data() + buf.size(),
+                                           second, loaded2) &&
+             View().open(two.data() + buf.size(), second);
+        algo::binary_tree_serialize(loaded2, again2);
+        ok = ok && again2 == buf;
+        algo::binary_tree_destroy_tree(pool, loaded2);
+
+        // truncated, of another type, with a broken shape
+        BinaryTreeNode *broken = nullptr;
+        ok = ok && !algo::binary_tree_deserialize(buf.data(), buf.size() - 1,
+                                                  broken) &&
+             !view.open(buf.data(), buf.size() - 1);
+        algo::binary_tree_node_pool<algo::binary_tree_node<double> > dpool;
+        algo::binary_tree_node<double> *dbroken = nullptr;
+        ok = ok && !algo::binary_tree_deserialize(dpool, buf.data(),
+                                                  buf.size(), dbroken);
+        if (size > 1) {
+            std::vector<char> bad(buf);
+            bad[16] ^= 1;  // the root's left child bit
+            ok = ok && !algo::binary_tree_deserialize(pool, bad.data(),
+                                                      bad.size(), broken) &&
+                 !View().open(bad.data(), bad.size()) &&
+                 pool.size() == (size_t)size && !broken;
+        }
+        algo::binary_tree_destroy_tree(root);
+    }
+
+    // a random BST
+    algo::binary_tree_node_pool<BinaryTreeNode> pool;
+    std::vector<int> keys(n);
+    for (auto &k : keys)
+        k = rand();
+    BinaryTreeNode *root = algo::binary_tree_new_node(pool, keys[0]);
+    for (int i = 1; i < n; i++)
+        algo::binary_tree_insert_bst(pool, root, keys[i]);
+
+    std::vector<char> buf;
+    auto t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_serialize(root, buf);
+    double save = seconds_since(t0);
+    double mb = buf.size() / 1e6;
+
+    algo::binary_tree_node_pool<BinaryTreeNode> load_pool;
+    BinaryTreeNode *loaded = nullptr;
+    t0 = std::chrono::steady_clock::now();
+    ok = ok && algo::binary_tree_deserialize(load_pool, buf.data(), buf.size(),
+                                             loaded);
+    double load = seconds_since(t0);
+
+    BinaryTreeNode *heap_loaded = nullptr;
+    t0 = std::chrono::steady_clock::now();
+    ok = ok && algo::binary_tree_deserialize(buf.data(), buf.size(),
+                                             heap_loaded);
+    double heap_load = seconds_since(t0);
+    algo::binary_tree_destroy_tree(heap_loaded);
+
+    // through a file mapped into memory
+    char path[] = "/tmp/binary_tree_XXXXXX";
+    int fd = mkstemp(path);
+    ok = ok && fd >= 0 &&
+         write(fd, buf.data(), buf.size()) == (ssize_t)buf.size();
+    void *map = MAP_FAILED;
+    if (fd >= 0) {
+        map = mmap(nullptr, buf.size(), PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        unlink(path);
+    }
+    ok = ok && map != MAP_FAILED;
+
+    View view;
+    double open = 0, view_search = 0, tree_search = 0;
+    size_t view_found = 0, tree_found = 0;
+    if (map != MAP_FAILED) {
+        t0 = std::chrono::steady_clock::now();
+        ok = ok && view.open(static_cast<const char*>(map), buf.size());
+        open = seconds_since(t0);
+
+        t0 = std::chrono::steady_clock::now();
+        for (int k : keys)
+            view_found += view.search(k) != View::npos;
+        view_search = seconds_since(t0);
+        munmap(map, buf.size());
+    }
+    t0 = std::chrono::steady_clock::now();
+    for (int k : keys)
+        tree_found += algo::binary_tree_search_bst(loaded, k) != nullptr;
+    tree_search = seconds_since(t0);
+
+    // the loaded tree is in one block, in preorder
+    std::vector<char> again;
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_serialize(loaded, again);
+    double resave = seconds_since(t0);
+    ok = ok && again == buf && load_pool.size() == pool.size() &&
+         view_found == (size_t)n && tree_found == (size_t)n;
+
+    std::cout << "serialized BST of " << pool.size() << " nodes: " << mb
+              << " MB" << std::endl;
+    std::cout << "serialize           " << save << " sec, " << mb / save
+              << " MB/s" << std::endl;
+    std::cout << "serialize loaded    " << resave << " sec, " << mb / resave
+              << " MB/s" << std::endl;
+    std::cout << "load to node pool   " << load << " sec, " << mb / load
+              << " MB/s" << std::endl;
+    std::cout << "load with new       " << heap_load << " sec, "
+              << mb / heap_load << " MB/s" << std::endl;
+    std::cout << "open a mapped view  " << open << " sec, " << mb / open
+              << " MB/s" << std::endl;
+    std::cout << "search " << n << " keys: view " << view_search
+              << " sec, loaded tree " << tree_search << " sec" << std::endl;
+
+    if (!ok)
+        std::cout << "Error!" << std::endl;
+    return ok;
+}
 
 int main(int argc, char *argv[])
 {
@@ -116,5 +1151,70 @@ int main(int argc, char *argv[])
     algo::binary_tree_print(root);
     algo::binary_tree_destroy_tree(root);
 
+    // node pool
+
+    std::cout << std::endl;
+    if (!run_pool_benchmark(1000000))
+        return 2;
+
+    // AVL tree
+
+    std::cout << std::endl;
+    if (!check_avl(2000, 300)) {
+        std::cout << "AVL: Error!" << std::endl;
+        return 2;
+    }
+    run_avl_benchmark(20000);
+
+    // order statistics
+
+    std::cout << std::endl;
+    if (!check_os(2000, 300)) {
+        std::cout << "order statistics: Error!" << std::endl;
+        return 2;
+    }
+    if (!run_os_benchmark(1000000, 100))
+        return 2;
+
+    // flat layout
+
+    std::cout << std::endl;
+    for (int n : { 1, 2, 3, 7, 8, 100 }) {
+        if (!run_eytzinger_benchmark(n))
+            return 2;
+    }
+    if (!run_eytzinger_benchmark(1000000))
+        return 2;
+
+    // traversals
+
+    std::cout << std::endl;
+    if (!run_traversal_benchmark(1000000))
+        return 2;
+
+    // parallel
+
+    std::cout << std::endl;
+    if (!run_parallel_benchmark(1000000, 4))
+        return 2;
+
+    // bulk build
+
+    std::cout << std::endl;
+    if (!run_build_benchmark(1000000))
+        return 2;
+
+    // balance and diagrams of large trees
+
+    std::cout << std::endl;
+    if (!run_balance_print_benchmark(10000000, 100000))
+        return 2;
+
+    // serialization
+
+    std::cout << std::endl;
+    if (!run_serialize_benchmark(1000000))
+        return 2;
+
     return 0;
 }
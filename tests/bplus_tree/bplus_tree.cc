@@ -0,0 +1,190 @@
+#include <vector>
+#include <set>
+#include <iterator>
+#include <algorithm>
+#include <iostream>  // std::cout
+#include <functional>
+#include <stdlib.h>  // rand()
+#include <chrono>
+
+#include <boost/program_options.hpp>
+#include <boost/format.hpp>
+
+#include "algo/bplus_tree.hpp"
+#include "algo/binary_tree.hpp"
+
+namespace po = boost::program_options;
+
+using BinaryTreeNode = algo::binary_tree_node<int>;
+
+// Random inserts, searches and range scans checked against std::set
+template <typename Tree, typename Comparator>
+bool check_bplus_tree(int n, int range, Comparator comp)
+{
+    Tree tree(comp);
+    std::set<int, Comparator> ref(comp);
+
+    for (int i = 0; i < n; i++) {
+        int value = rand() % range;
+        if (tree.insert(value) != ref.insert(value).second) {
+            return false;
+        }
+    }
+    if (tree.size() != ref.size()) {
+        return false;
+    }
+
+    for (int value = -1; value <= range; value++) {
+        const int *found = tree.search(value);
+        if ((found != nullptr) != (ref.count(value) != 0) ||
+            (found && *found != value)) {
+            return false;
+        }
+    }
+
+    for (int t = 0; t < 100; t++) {
+        int lo = rand() % range, hi = rand() % range;
+        if (comp(hi, lo)) {
+            std::swap(lo, hi);
+        }
+        std::vector<int> v, vref(ref.lower_bound(lo), ref.lower_bound(hi));
+        tree.range(lo, hi, [ & ] (int x) { v.push_back(x); });
+        if (v != vref) {
+            return false;
+        }
+    }
+    return true;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point t0)
+{
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+// Inserts, searches and a range scan of n random keys in a BST and
+// B+ trees with different node sizes
+template <size_t NodeBytes>
+void bench_bplus_tree(const std::vector<int> &keys,
+                      const std::vector<int> &queries, long long bst_sum)
+{
+    algo::bplus_tree<int, std::less<int>, NodeBytes> tree;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int k : keys) {
+        tree.insert(k);
+    }
+    double insert = seconds_since(t0);
+
+    size_t found = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int q : queries) {
+        found += tree.search(q) != nullptr;
+    }
+    double search = seconds_since(t0);
+
+    long long sum = 0;
+    t0 = std::chrono::steady_clock::now();
+    tree.range(0, keys.size(), [ & ] (int x) { sum += x; });
+    double scan = seconds_since(t0);
+
+    std::cout << boost::format("%-14s %8.4f %8.4f %8.6f  %8.2f M/s "
+                               "(height %d, found %d)%s\n")
+        % (boost::format("B+ tree %d") % NodeBytes) % insert % search % scan
+        % (queries.size() / search / 1e6) % tree.height() % found
+        % (sum == bst_sum ? "" : " Error!");
+}
+
+void bench(int n)
+{
+    std::vector<int> keys(n), queries(n);
+    for (int i = 0; i < n; i++) {
+        keys[i] = rand() % (2 * n);
+        queries[i] = rand() % (2 * n);
+    }
+
+    std::cout << boost::format("%d random keys, %d searches, "
+                               "a range scan of a half\n") % n % n;
+    std::cout << boost::format("%-14s %8s %8s %8s  %8s (sec)\n")
+        % "" % "insert" % "search" % "scan" % "search";
+
+    algo::binary_tree_node_pool<BinaryTreeNode> pool;
+    auto t0 = std::chrono::steady_clock::now();
+    BinaryTreeNode *root = algo::binary_tree_new_node(pool, keys[0]);
+    for (int i = 1; i < n; i++) {
+        algo::binary_tree_insert_bst(pool, root, keys[i]);
+    }
+    double insert = seconds_since(t0);
+
+    size_t found = 0;
+    t0 = std::chrono::steady_clock::now();
+    for (int q : queries) {
+        found += algo::binary_tree_search_bst(root, q) != nullptr;
+    }
+    double search = seconds_since(t0);
+
+    long long sum = 0;
+    t0 = std::chrono::steady_clock::now();
+    algo::binary_tree_traverse_inorder(root, [ & ] (BinaryTreeNode *node) {
+            if (node->data < n) {
+                sum += node->data;
+            }
+        });
+    double scan = seconds_since(t0);
+
+    std::cout << boost::format("%-14s %8.4f %8.4f %8.6f  %8.2f M/s "
+                               "(found %d)\n")
+        % "BST" % insert % search % scan % (n / search / 1e6) % found;
+
+    bench_bplus_tree<64>(keys, queries, sum);
+    bench_bplus_tree<256>(keys, queries, sum);
+    bench_bplus_tree<1024>(keys, queries, sum);
+}
+
+int main(int argc, char *argv[])
+{
+    int n = 0;
+
+    po::options_description desc("Allowed options");
+    desc.add_options()
+        ("help,h", "Show help")
+        ("bench", po::value<int>(&n),
+         "Benchmark against a BST with this number of random keys");
+
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if (n > 0) {
+        bench(n);
+        return 0;
+    }
+
+    int ret = 0;
+
+    // tiny nodes for deep trees with many splits, the default ones,
+    // and the generic (non-SIMD) node search
+    using less = std::less<int>;
+    using greater = std::greater<int>;
+    for (int range : { 10, 1000, 100000 }) {
+        if (!check_bplus_tree<algo::bplus_tree<int, less, 16>>(
+                range, range, less()) ||
+            !check_bplus_tree<algo::bplus_tree<int, less, 20>>(
+                range, range, less()) ||
+            !check_bplus_tree<algo::bplus_tree<int>>(
+                range, range, less()) ||
+            !check_bplus_tree<algo::bplus_tree<int, greater, 64>>(
+                range, range, greater())) {
+            std::cout << "range " << range << ": Error!" << std::endl;
+            ret = 2;
+        }
+    }
+
+    std::cout << (ret ? "FAILED" : "OK") << std::endl;
+    return ret;
+}
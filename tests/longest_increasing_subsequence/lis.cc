@@ -1,7 +1,12 @@
 #include <vector>
 #include <iterator> 
 #include <algorithm> // std::max()
+#include <functional> // std::less_equal
 #include <iostream>  // std::cin, std::cout
+#include <chrono>
+#include <limits>    // std::numeric_limits
+#include <stdexcept> // std::runtime_error
+#include <stdint.h>  // uint64_t
 #include <stdlib.h>  // rand()
 #include <time.h>    // time()
 
@@ -19,7 +24,7 @@ void print_lis(const std::vector<int> &seq,
     size_t j = 0;
     for (size_t i = 0; i < seq.size(); i++) {
 
-        if (i == lis[j]) {
+        if (j < lis.size() && i == lis[j]) {
             std::cout << boost::format("%2s%1s ") % seq[i] % "+";
             j++;
         } else {
@@ -29,11 +34,121 @@ void print_lis(const std::vector<int> &seq,
     std::cout << std::endl;
 }
 
+bool check_lis(const std::vector<int> &seq,
+               const std::vector<size_t> &lis,
+               bool strict = true)
+{
+    // indices must be strictly increasing, values as well
+    // (or non-decreasing, if not strict)
+    for (size_t k = 1; k < lis.size(); k++) {
+        if (lis[k-1] >= lis[k] ||
+            (strict && !(seq[lis[k-1]] < seq[lis[k]])) ||
+            (!strict && seq[lis[k]] < seq[lis[k-1]])) {
+            return false;
+        }
+    }
+    return lis.empty() || lis.back() < seq.size();
+}
+
+// O(N^2) reference for the maximum-weight increasing subsequence
+long weighted_lis_dp(const std::vector<int> &seq,
+                     const std::vector<long> &wgt)
+{
+    std::vector<long> best(seq.size(), 0);
+    long maxw = 0;
+    for (size_t i = 0; i < seq.size(); i++) {
+        long w = 0;
+        for (size_t j = 0; j < i; j++) {
+            if (seq[j] < seq[i]) {
+                w = std::max(w, best[j]);
+            }
+        }
+        best[i] = w + wgt[i];
+        maxw = (i == 0) ? best[i] : std::max(maxw, best[i]);
+    }
+    return maxw;
+}
+
+// O(N^2) reference for the number of LIS (mod 2^64), overflow is set if
+// the count has wrapped
+uint64_t lis_count_dp(const std::vector<int> &seq, bool &overflow)
+{
+    std::vector<size_t> len(seq.size(), 1);
+    std::vector<uint64_t> cnt(seq.size(), 1);
+    std::vector<char> wrapped(seq.size(), 0);
+    size_t maxlen = 0;
+    uint64_t total = 0;
+    overflow = false;
+    for (size_t i = 0; i < seq.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            if (seq[j] < seq[i]) {
+                if (len[j] + 1 > len[i]) {
+                    len[i] = len[j] + 1;
+                    cnt[i] = cnt[j];
+                    wrapped[i] = wrapped[j];
+                } else if (len[j] + 1 == len[i]) {
+                    cnt[i] += cnt[j];
+                    wrapped[i] |= wrapped[j] || cnt[i] < cnt[j];
+                }
+            }
+        }
+        if (len[i] > maxlen) {
+            maxlen = len[i];
+            total = cnt[i];
+            overflow = wrapped[i];
+        } else if (len[i] == maxlen) {
+            total += cnt[i];
+            overflow = overflow || wrapped[i] || total < cnt[i];
+        }
+    }
+    return total;
+}
+
+// Batch LIS of float rows with +inf next to longer rows: the unused tails
+// of the shorter rows must not count as less than +inf
+bool check_batch_inf(unsigned threads)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+    std::vector<float> block = {    1,   2,   3,   4,   5,
+                                  inf, inf, inf, inf, inf,
+                                 -inf,   0, inf, inf,   1 };
+    std::vector<size_t> lens(3);
+    algo::longest_increasing_subsequence_batch(block.begin(),
+                                               (std::ptrdiff_t)3,
+                                               (std::ptrdiff_t)5,
+                                               lens.begin(), threads);
+    return lens == std::vector<size_t>({ 5, 1, 3 });
+}
+
+// A range that throws in one of the batch threads: the exception reaches
+// the caller once all the threads are joined
+bool check_parallel_throw(unsigned threads)
+{
+    bool caught = false;
+    try {
+        algo::parallel_for_ranges((std::ptrdiff_t)100, (std::ptrdiff_t)8,
+                                  std::max(2u, threads),
+                                  [ ] (std::ptrdiff_t b, std::ptrdiff_t e) {
+                                      if (b <= 90 && 90 < e)
+                                          throw std::runtime_error("range");
+                                  });
+    } catch (const std::runtime_error &) {
+        caught = true;
+    }
+    return caught;
+}
+
 int main(int argc, char *argv[])
 {
     size_t size = 10;
+    size_t chunk = 0;
+    unsigned threads = 1;
     int minval = 0;
     int maxval = 100;
+    int maxweight = 100;
+    uint64_t modulo = 0;
+    uint64_t enum_max = 1000;
+    size_t ref_max = 20000;
     int verbose = 0;
     
     po::options_description desc("Allowed options");
@@ -42,13 +157,27 @@ int main(int argc, char *argv[])
         ("verbose,v", po::value<int>(&verbose)->default_value(verbose),
          "Verbose output level: 0, 1 or 2")
         ("lis", po::value<std::string>()->default_value("all"),
-         "LIS algorithm:\n<dp | nlogn | all>")
+         "LIS algorithm:\n<dp | nlogn | workspace | batch | batch-lis |\n"
+         " weighted | nondecr | count | all>")
         ("size", po::value<size_t>(&size)->default_value(size),
          "Size of the input array for LIS")
+        ("chunk", po::value<size_t>(&chunk)->default_value(chunk),
+         "Split the input into many small sequences of this size\n"
+         "(nlogn, workspace, batch, batch-lis and all)")
+        ("threads", po::value<unsigned>(&threads)->default_value(threads),
+         "Number of threads (batch and batch-lis only)")
         ("minval", po::value<int>(&minval)->default_value(minval),
          "Min random value of the array")
         ("maxval", po::value<int>(&maxval)->default_value(maxval),
-         "Max random value of the array");
+         "Max random value of the array")
+        ("maxweight", po::value<int>(&maxweight)->default_value(maxweight),
+         "Max random weight of an element, >= 1 (weighted LIS)")
+        ("modulo", po::value<uint64_t>(&modulo)->default_value(modulo),
+         "Modulo for the number of LIS (0 = 2^64)")
+        ("enum-max", po::value<uint64_t>(&enum_max)->default_value(enum_max),
+         "Max number of LIS to enumerate")
+        ("ref-max", po::value<size_t>(&ref_max)->default_value(ref_max),
+         "Max size for the O(N^2) weighted and count references (all)");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -57,7 +186,14 @@ int main(int argc, char *argv[])
     if (vm.count("help") ||
         (vm["lis"].as<std::string>() != "dp" &&
          vm["lis"].as<std::string>() != "nlogn" &&
-         vm["lis"].as<std::string>() != "all")) {
+         vm["lis"].as<std::string>() != "workspace" &&
+         vm["lis"].as<std::string>() != "batch" &&
+         vm["lis"].as<std::string>() != "batch-lis" &&
+         vm["lis"].as<std::string>() != "weighted" &&
+         vm["lis"].as<std::string>() != "nondecr" &&
+         vm["lis"].as<std::string>() != "count" &&
+         vm["lis"].as<std::string>() != "all") ||
+        maxweight < 1) {
         std::cout << desc << std::endl;
         return 1;
     }
@@ -72,6 +208,15 @@ int main(int argc, char *argv[])
                   [ minval, maxval ]() -> int
                   { return minval + rand() % (maxval - minval + 1); });
 
+    const std::string &type = vm["lis"].as<std::string>();
+    std::vector<long> wgt;
+    if (type == "weighted" || type == "all") {
+        wgt.resize(size);
+        std::generate(wgt.begin(), wgt.end(),
+                      [ maxweight ]() -> long
+                      { return 1 + rand() % maxweight; });
+    }
+
     if (verbose > 1) {
         std::cout << boost::format("LIS type: %s\n") % vm["lis"].as<std::string>();
         std::cout << "seq  = ";
@@ -86,6 +231,80 @@ int main(int argc, char *argv[])
               std::back_inserter(seq));
     */
 
+    // many small sequences: split the input into chunks and compute
+    // LIS of every chunk, either allocating, reusing one workspace
+    // or with the batch API
+    if (chunk) {
+        const size_t nchunks = seq.size() / chunk;
+        algo::lis_workspace<std::ptrdiff_t> ws;
+        std::vector<size_t> lis_chunk;
+        std::vector<size_t> lens_nlogn(nchunks), lens_ws(nchunks);
+        std::vector<size_t> lens_batch(nchunks), lens_batch_lis(nchunks);
+        std::vector<size_t> lises(type == "batch-lis" || type == "all" ?
+                                  nchunks * chunk : 0);
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (size_t c = 0; c < nchunks; c++) {
+            if (type == "nlogn" || type == "all") {
+                lis_chunk.clear();
+                lens_nlogn[c] = algo::longest_increasing_subsequence(
+                    seq.begin() + c * chunk, seq.begin() + (c + 1) * chunk,
+                    std::back_inserter(lis_chunk));
+            }
+            if (type == "workspace" || type == "all") {
+                lis_chunk.clear();
+                lens_ws[c] = algo::longest_increasing_subsequence(
+                    seq.begin() + c * chunk, seq.begin() + (c + 1) * chunk, ws,
+                    std::back_inserter(lis_chunk));
+            }
+        }
+        if (type == "batch" || type == "all") {
+            algo::longest_increasing_subsequence_batch(
+                seq.begin(), (std::ptrdiff_t)nchunks, (std::ptrdiff_t)chunk,
+                lens_batch.begin(), threads);
+            if (!check_batch_inf(threads) || !check_parallel_throw(threads)) {
+                std::cout << "error: batch LIS with +inf elements "
+                          << "or a throwing thread" << std::endl;
+                return 2;
+            }
+        }
+        if (type == "batch-lis" || type == "all") {
+            algo::longest_increasing_subsequence_batch_lis(
+                seq.begin(), (std::ptrdiff_t)nchunks, (std::ptrdiff_t)chunk,
+                lens_batch_lis.begin(), lises.begin(), threads);
+        }
+        std::chrono::duration<double> sec =
+            std::chrono::steady_clock::now() - t0;
+
+        if (verbose) {
+            std::cout << boost::format("%d sequences of %d, "
+                                       "%.0f sequences/sec\n")
+                % nchunks % chunk % (nchunks / sec.count());
+        }
+
+        if (type == "all") {
+            for (size_t c = 0; c < nchunks; c++) {
+                std::vector<int> row(seq.begin() + c * chunk,
+                                     seq.begin() + (c + 1) * chunk);
+                std::vector<size_t> lis_row(lises.begin() + c * chunk,
+                                            lises.begin() + c * chunk +
+                                            lens_batch_lis[c]);
+                if (lens_ws[c] != lens_nlogn[c] ||
+                    lens_batch[c] != lens_nlogn[c] ||
+                    lens_batch_lis[c] != lens_nlogn[c] ||
+                    !check_lis(row, lis_row)) {
+                    std::cout << boost::format("error: chunk %d, nlogn = %d, "
+                                               "workspace = %d, batch = %d, "
+                                               "batch-lis = %d\n")
+                        % c % lens_nlogn[c] % lens_ws[c] % lens_batch[c]
+                        % lens_batch_lis[c];
+                    return 2;
+                }
+            }
+        }
+        return 0;
+    }
+
     // compute longest increasing subsequence
     std::vector<size_t> lis_dp;
     std::vector<size_t> lis_nlogn;
@@ -102,9 +321,134 @@ int main(int argc, char *argv[])
                                              std::back_inserter(lis_nlogn));
     }
     
+    std::vector<size_t> lis_ws;
+    if (type == "workspace" || type == "all") {
+        algo::lis_workspace<std::ptrdiff_t> ws;
+        // twice: the second call runs on the grown buffers
+        algo::longest_increasing_subsequence(seq.begin(), seq.end(), ws);
+        algo::longest_increasing_subsequence(seq.begin(), seq.end(), ws,
+                                             std::back_inserter(lis_ws));
+    }
+
+    std::vector<size_t> lis_weighted;
+    long weight = 0;
+    if (type == "weighted" || type == "all") {
+        weight = algo::longest_increasing_subsequence_weighted(
+            seq.begin(), seq.end(), wgt.begin(), std::back_inserter(lis_weighted));
+    }
+
+    std::vector<size_t> lis_nondecr;
+    if (type == "nondecr" || type == "all") {
+        algo::longest_non_decreasing_subsequence(seq.begin(), seq.end(),
+                                                 std::back_inserter(lis_nondecr));
+    }
+
+    uint64_t lis_count = 0, lis_enumerated = 0;
+    if (type == "count" || type == "all") {
+        lis_count = algo::longest_increasing_subsequence_count(
+            seq.begin(), seq.end(), modulo);
+
+        algo::lis_enumerator<std::vector<int>::iterator>
+            lisenum(seq.begin(), seq.end());
+        std::vector<size_t> lis_enum;
+        while (lis_enumerated < enum_max && lisenum.next()) {
+            lis_enumerated++;
+            lis_enum.assign(lisenum.lis().begin(), lisenum.lis().end());
+            if (!check_lis(seq, lis_enum) ||
+                lis_enum.size() != (size_t)lisenum.length()) {
+                std::cout << "error: enumerated lis is not valid" << std::endl;
+                return 2;
+            }
+            if (verbose > 1) {
+                std::cout << "lis_enum   = ";
+                print_lis(seq, lis_enum);
+            }
+        }
+    }
+
+    int ret = 0;
+    if (!check_lis(seq, lis_dp) || !check_lis(seq, lis_nlogn) ||
+        !check_lis(seq, lis_ws) ||
+        !check_lis(seq, lis_weighted) || !check_lis(seq, lis_nondecr, false)) {
+        std::cout << "error: lis is not an increasing subsequence" << std::endl;
+        ret = 2;
+    }
+    if (vm["lis"].as<std::string>() == "all" &&
+        lis_dp.size() != lis_nlogn.size()) {
+        std::cout << boost::format("error: lis_dp.size() = %d, "
+                                   "lis_nlogn.size() = %d\n")
+            % lis_dp.size() % lis_nlogn.size();
+        ret = 2;
+    }
+
+    long witness = 0;
+    for (size_t i : lis_weighted) {
+        witness += wgt[i];
+    }
+    if (witness != weight) {
+        std::cout << boost::format("error: weight = %d, witness weight = %d\n")
+            % weight % witness;
+        ret = 2;
+    }
+
+    // the quadratic references only for small inputs, so that the all mode
+    // checks of the other algorithms scale
+    const bool naive_refs = seq.size() <= ref_max;
+
+    if (type == "all" && modulo == 0 && naive_refs) {
+        // a wrapped count can't be compared to the enumerated LISes
+        bool overflow;
+        uint64_t count_dp = lis_count_dp(seq, overflow);
+        if (lis_count != count_dp ||
+            (!overflow && lis_count <= enum_max &&
+             lis_enumerated != lis_count)) {
+            std::cout << boost::format("error: lis_count = %d, "
+                                       "lis_count_dp = %d%s, "
+                                       "lis_enumerated = %d\n")
+                % lis_count % count_dp % (overflow ? " (wrapped)" : "")
+                % lis_enumerated;
+            ret = 2;
+        }
+    }
+
+    if (type == "all" &&
+        algo::longest_increasing_subsequence_count(seq.begin(), seq.end(),
+                                                   1) != 0) {
+        std::cout << "error: lis_count modulo 1 is not 0" << std::endl;
+        ret = 2;
+    }
+
+    if (type == "all") {
+        // cross-check the Fenwick engine against the other algorithms
+        long weight_dp = naive_refs ? weighted_lis_dp(seq, wgt) : weight;
+        long lislen_unit = algo::longest_increasing_subsequence_weighted(
+            seq.begin(), seq.end(), algo::lis_unit_weights<long>());
+        size_t nondecr_nlogn = algo::longest_increasing_subsequence(
+            seq.begin(), seq.end(), algo::null_output_iterator(),
+            std::less_equal<int>());
+
+        if (weight != weight_dp ||
+            (size_t)lislen_unit != lis_nlogn.size() ||
+            lis_ws != lis_nlogn ||
+            nondecr_nlogn != lis_nondecr.size()) {
+            std::cout << boost::format("error: weight = %d, weight_dp = %d\n"
+                                       "lislen_unit = %d, lis_nlogn.size() = %d\n"
+                                       "lis_nondecr.size() = %d, "
+                                       "nondecr_nlogn = %d\n")
+                % weight % weight_dp % lislen_unit % lis_nlogn.size()
+                % lis_nondecr.size() % nondecr_nlogn;
+            ret = 2;
+        }
+    }
+
     if (verbose) {
         std::cout << "lis_dp.size()    = " << lis_dp.size() << std::endl;
         std::cout << "lis_nlogn.size() = " << lis_nlogn.size() << std::endl;
+        std::cout << "lis_weighted     = " << weight << " ("
+                  << lis_weighted.size() << " elements)" << std::endl;
+        std::cout << "lis_nondecr.size() = " << lis_nondecr.size() << std::endl;
+        std::cout << "lis_count        = " << lis_count << " ("
+                  << lis_enumerated << " enumerated)" << std::endl;
     }
     
     if (verbose > 1) {
@@ -117,7 +461,17 @@ int main(int argc, char *argv[])
         std::copy (lis_nlogn.begin(), lis_nlogn.end(), out_it);
         std::cout << " => ";
         print_lis(seq, lis_nlogn);
+
+        std::cout << "lis_weighted = ";
+        std::copy (lis_weighted.begin(), lis_weighted.end(), out_it);
+        std::cout << " => ";
+        print_lis(seq, lis_weighted);
+
+        std::cout << "lis_nondecr  = ";
+        std::copy (lis_nondecr.begin(), lis_nondecr.end(), out_it);
+        std::cout << " => ";
+        print_lis(seq, lis_nondecr);
     }
 
-    return 0;
+    return ret;
 }
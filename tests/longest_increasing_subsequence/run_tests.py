@@ -26,9 +26,38 @@ def tc02_dp():
     test_utils.run_seq_memo("Testing memory usage:",
                             seq, cmd, "out_memo_dp", 1, "kb")
 
+def tc03_all():
+    n = 10**5
+    seq = [n/10*i for i in range(1, 11)]
+    cmd = "./lis --lis all --maxval 1000000 --size $x"
+
+    test_utils.run_seq_time("Testing run time (dp vs nlogn cross-check):",
+                            seq, cmd, "out_time_all", 1)
+
+def tc04_weighted():
+    n = 10**7
+    seq = [n/10*i for i in range(1, 11)]
+    cmd = "./lis --lis weighted --maxval 1000000000 --size $x"
+
+    test_utils.run_seq_time("Testing run time:",
+                            seq, cmd, "out_time_weighted", 5)
+
+    test_utils.run_seq_memo("Testing memory usage:",
+                            seq, cmd, "out_memo_weighted", 1, "mb")
+
+def tc05_small_sequences():
+    seq = [10, 20, 50, 100, 200, 500, 1000]
+    for lis in ["nlogn", "workspace", "batch", "batch-lis"]:
+        cmd = "./lis --lis " + lis + " --size 10000000 --chunk $x"
+        test_utils.run_seq_time("Testing run time (10M elements in chunks):",
+                                seq, cmd, "out_time_chunks_" + lis, 1)
+
 def run_tests():
     tc01_nlogn()
     tc02_dp()
+    tc03_all()
+    tc04_weighted()
+    tc05_small_sequences()
 
 def run_gnuplot():
     gp = dict(outpng  = "plot_dp.png",
@@ -58,6 +87,19 @@ def run_gnuplot():
               rmaxy1  = "10")
     test_utils.gnuplot_x1y2p2(gp)
 
+    gp = dict(outpng  = "plot_weighted.png",
+              title   = "Weighted LIS - Fenwick tree O(N log(N))^{}",
+              labelx  = "Size of the input sequence",
+              labely1 = "Time (sec)",
+              labely2 = "Memory (Mb)",
+              title1  = "time",
+              title2  = "memory",
+              file1   = "out_time_weighted",
+              file2   = "out_memo_weighted",
+              rminy1  = "*",
+              rmaxy1  = "10")
+    test_utils.gnuplot_x1y2p2(gp)
+
 def main():
     run_tests()
     run_gnuplot()